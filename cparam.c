@@ -1,9 +1,24 @@
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cparam.h"
+#include "cparam_internal.h"
+#include "cparam_rcu.h"
+#include "cparam_trace.h"
+
+/* Most keywords suggested for an unmatched keyword. */
+#define CPARAM_SUGGEST_MAX 3
+/* Largest edit distance that is still worth suggesting. */
+#define CPARAM_SUGGEST_DIST_MAX 3
+/* FNV-1a, for hashing arguments. */
+#define CPARAM_FNV_OFFSET UINT64_C(0xcbf29ce484222325)
+#define CPARAM_FNV_PRIME UINT64_C(0x100000001b3)
 
 struct cparam_info *
 cparam_next(struct cparam_info * const param)
@@ -27,25 +42,370 @@ cparam_next(struct cparam_info * const param)
     return NULL;
 }
 
+/* Message id of why the last parse on this thread failed. */
+static _Thread_local unsigned int cparam_error_id = 0;
+
+unsigned int
+cparam_error(void)
+{
+    return cparam_error_id;
+}
+
+/*
+    Record that parsing failed, and why. err_msg gets the message for msg_id,
+    formatted with the arguments after it, and the length is returned the way
+    snprintf() does. Built with CPARAM_REALTIME, only the id is recorded,
+    since formatting needs stdio.
+ */
+static int
+cparam_fail(
+    char * const err_msg,
+    const size_t err_msg_size,
+    const unsigned int msg_id,
+    ...
+) {
+    cparam_error_id = msg_id;
+#ifdef CPARAM_REALTIME
+    if ((NULL != err_msg) && (err_msg_size > 0))
+    {
+        err_msg[0] = '\0';
+    }
+    return 0;
+#else
+    if (NULL == err_msg)
+    {
+        return 0;
+    }
+    va_list msg_args;
+    va_start(msg_args, msg_id);
+    const int msg_len =
+        vsnprintf(err_msg, err_msg_size, cparam_msg(msg_id), msg_args);
+    va_end(msg_args);
+    return msg_len;
+#endif
+}
+
+/* Digit value of c in any base up to 36, or 36 if it isn't one. */
+static inline unsigned int
+cparam_digit(const char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+    if ((c >= 'a') && (c <= 'z'))
+    {
+        return c - 'a' + 10;
+    }
+    if ((c >= 'A') && (c <= 'Z'))
+    {
+        return c - 'A' + 10;
+    }
+    return 36;
+}
+
+/*
+    Same as strtol(str, end, 0) in the "C" locale, but without looking up the
+    locale, which can take a lock. Out of range values are clamped to LONG_MIN
+    or LONG_MAX.
+ */
+static long
+cparam_strtol(const char * const str, const char ** const end)
+{
+    const char * str_ptr = str;
+    while ((' ' == *str_ptr) || ((*str_ptr >= '\t') && (*str_ptr <= '\r')))
+    {
+        str_ptr++;
+    }
+    const bool is_negative = ('-' == *str_ptr);
+    if (('-' == *str_ptr) || ('+' == *str_ptr))
+    {
+        str_ptr++;
+    }
+    unsigned int base = 10;
+    if ('0' == str_ptr[0])
+    {
+        base = 8;
+        if ( (('x' == str_ptr[1]) || ('X' == str_ptr[1]))
+          && (cparam_digit(str_ptr[2]) < 16) )
+        {
+            base = 16;
+            str_ptr += 2;
+        }
+    }
+    const unsigned long val_max =
+        is_negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    const char * const digits = str_ptr;
+    unsigned long val = 0;
+    for (unsigned int digit = cparam_digit(*str_ptr);
+        digit < base;
+        digit = cparam_digit(*++str_ptr))
+    {
+        val = (val > (val_max - digit) / base) ? val_max : val * base + digit;
+    }
+    if (digits == str_ptr)
+    {
+        *end = str;
+        return 0;
+    }
+    *end = str_ptr;
+    if (is_negative)
+    {
+        return (0 == val) ? 0 : -(long)(val - 1) - 1;
+    }
+    return (long)val;
+}
+
+#ifndef CPARAM_REALTIME
+
+/*
+    Levenshtein distance between pattern and text, using the bit-parallel
+    algorithm of Myers (1999) in the global form given by Hyyro (2001). Each
+    pattern position is one bit of a column of the dynamic programming matrix,
+    so the whole column is updated in a few word operations per text
+    character.
+
+    peq holds, for each byte value, the bits of the pattern positions with that
+    byte. pattern_len must be 1 to 64.
+
+    Returns max_dist + 1 as soon as the distance can't be max_dist or less.
+ */
+static unsigned int
+cparam_edit_distance(
+    const uint64_t peq[256],
+    const size_t pattern_len,
+    const char * const text,
+    const size_t text_len,
+    const unsigned int max_dist
+) {
+    const uint64_t last_bit = (uint64_t)1 << (pattern_len - 1);
+    uint64_t pv = ~(uint64_t)0;
+    uint64_t mv = 0;
+    size_t score = pattern_len;
+
+    for (size_t text_idx = 0;text_idx < text_len;text_idx++)
+    {
+        const uint64_t eq = peq[(unsigned char)text[text_idx]];
+        const uint64_t xv = eq | mv;
+        const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (0 != (ph & last_bit))
+        {
+            score++;
+        }
+        else if (0 != (mh & last_bit))
+        {
+            score--;
+        }
+        /* Top row of the matrix is the text position, so it always goes up
+           by one. */
+        ph = (ph << 1) | 1;
+        mh = mh << 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        /* Each remaining text character can lower the score by at most one.
+         */
+        const size_t text_left = text_len - text_idx - 1;
+        if ((score > text_left) && (score - text_left > max_dist))
+        {
+            return max_dist + 1;
+        }
+    }
+    return (score > max_dist) ? max_dist + 1 : (unsigned int)score;
+}
+
+/*
+    Append a "did you mean" list of the keywords closest to an unmatched
+    argument to an error message. Nothing is appended if no keyword is close
+    enough, or if there isn't room for one. msg_size must be at least 1.
+ */
+static void
+cparam_suggest(
+    const struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    char * const msg,
+    const size_t msg_size
+) {
+    if ((0 == arg_len) || (arg_len > 64))
+    {
+        return;
+    }
+    /* Allow about one edit in three characters, so short typos still find
+       something but unrelated words don't. */
+    unsigned int max_dist = (unsigned int)(arg_len + 2) / 3;
+    if (max_dist > CPARAM_SUGGEST_DIST_MAX)
+    {
+        max_dist = CPARAM_SUGGEST_DIST_MAX;
+    }
+
+    uint64_t peq[256];
+    memset(peq, 0, sizeof(peq));
+    for (size_t arg_idx = 0;arg_idx < arg_len;arg_idx++)
+    {
+        peq[(unsigned char)arg[arg_idx]] |= (uint64_t)1 << arg_idx;
+    }
+
+    int found_idx[CPARAM_SUGGEST_MAX];
+    int num_found = 0;
+    const int key_lim = param->key_lim;
+    for (int key_idx = 0;key_idx < key_lim;key_idx++)
+    {
+        const char * const name = param->key_list[key_idx].name;
+        const size_t name_len = strlen(name);
+        const size_t len_diff =
+            (name_len > arg_len) ? name_len - arg_len : arg_len - name_len;
+        if (len_diff > max_dist)
+        {
+            continue;
+        }
+        const unsigned int dist =
+            cparam_edit_distance(peq, arg_len, name, name_len, max_dist);
+        if (dist < max_dist)
+        {
+            /* Closer than anything so far, start again. Keep looking for
+               others this close, but nothing further away. */
+            max_dist = dist;
+            num_found = 0;
+        }
+        if ((dist == max_dist) && (num_found < CPARAM_SUGGEST_MAX))
+        {
+            found_idx[num_found] = key_idx;
+            num_found++;
+        }
+    }
+
+    /* The list is cut short at a whole entry if it doesn't fit, and there's
+       always room left to end the sentence. */
+    const char * const end = cparam_msg(CPARAM_MSG_SUGGEST_END);
+    const size_t end_len = strlen(end);
+    size_t msg_len = 0;
+    for (int found_cnt = 0;found_cnt < num_found;found_cnt++)
+    {
+        const int len = snprintf(msg + msg_len, msg_size - msg_len,
+            cparam_msg(
+                (0 == found_cnt)
+                    ? CPARAM_MSG_SUGGEST_FIRST
+                    : CPARAM_MSG_SUGGEST_NEXT
+            ),
+            param->key_list[found_idx[found_cnt]].name
+        );
+        if ((len < 0) || ((size_t)len + end_len >= msg_size - msg_len))
+        {
+            break;
+        }
+        msg_len += len;
+    }
+    if (0 == msg_len)
+    {
+        // Not even one fits, or there weren't any.
+        msg[0] = '\0';
+        return;
+    }
+    memcpy(msg + msg_len, end, end_len + 1);
+}
+#else
+/* Nothing is formatted, and checking every keyword would take longer. */
+#define cparam_suggest(param, arg, arg_len, msg, msg_size)
+#endif
+
 static bool
-cparam_process_arg(
+cparam_process_keyval(
     const int argc,
     const char * const argv[],
+    const struct cparam_arg * const args,
     const int argv_current,
     struct cparam_info * const param,
     char * const err_msg,
+    const size_t err_msg_size,
+    int * const arg_cnt
+);
+
+/* Length of argv[arg_idx], from args if argv was scanned. */
+static size_t
+cparam_arg_len(
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int arg_idx
+) {
+    return (NULL != args) ? args[arg_idx].len : strlen(argv[arg_idx]);
+}
+
+/*
+    Check arg against the pattern of a CPARAM_PATTERN. If cparam_compile()
+    wasn't used, the pattern is compiled the first time, and kept in
+    param->dfa until cparam_compile_free(), except with CPARAM_REALTIME,
+    where that's an error since compiling uses the heap.
+ */
+static bool
+cparam_pattern_check(
+    struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    char * const err_msg,
     const size_t err_msg_size
 ) {
+    if (NULL == param->dfa)
+    {
+#ifdef CPARAM_REALTIME
+        cparam_fail(err_msg, err_msg_size,
+            CPARAM_MSG_PATTERN_NOT_COMPILED, param->pattern
+        );
+        return false;
+#else
+        unsigned int msg_id;
+        if ( !cparam_pattern_compile(param->pattern, &param->dfa,
+                &msg_id, err_msg, err_msg_size
+            )
+        ) {
+            cparam_error_id = msg_id;
+            return false;
+        }
+#endif
+    }
+    if (!cparam_pattern_match(param->dfa, arg, arg_len))
+    {
+        cparam_fail(err_msg, err_msg_size,
+            CPARAM_MSG_PATTERN_MISMATCH, arg, param->pattern
+        );
+        return false;
+    }
+    return true;
+}
+
+/*
+    Parse argv[argv_current] for one parameter. arg_cnt is set to the number of
+    arguments used, or on failure the offset from argv_current of the one that
+    failed. args is NULL if argv wasn't scanned by cparam_argv_scan().
+ */
+static bool
+cparam_process_arg(
+    const int argc,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int argv_current,
+    struct cparam_info * const param,
+    char * const err_msg,
+    const size_t err_msg_size,
+    int * const arg_cnt
+) {
+    *arg_cnt = 0;
     if (CPARAM_ACTION == param->type) {
         // Action parameter does not process an argument.
         return true;
     }
+    if (CPARAM_KEYVAL == param->type) {
+        // Can be any number of arguments, including none.
+        return cparam_process_keyval(
+            argc, argv, args, argv_current,
+            param, err_msg, err_msg_size, arg_cnt
+        );
+    }
     if (argv_current >= argc)
     {
-        if (NULL != err_msg)
-        {
-            snprintf(err_msg, err_msg_size, "Missing arguments.");
-        }
+        cparam_fail(err_msg, err_msg_size, CPARAM_MSG_MISSING_ARGUMENTS);
         return false;
     }
     switch (param->type)
@@ -53,22 +413,45 @@ cparam_process_arg(
     case CPARAM_STRING:
         param->str_val = argv[argv_current];
         break;
+    case CPARAM_PATTERN:
+        {
+            param->str_val = argv[argv_current];
+            if ( !cparam_pattern_check(
+                    param,
+                    argv[argv_current],
+                    cparam_arg_len(argv, args, argv_current),
+                    err_msg, err_msg_size
+                )
+            ) {
+                return false;
+            }
+        }
+        break;
     case CPARAM_INT:
         {
             param->str_val = argv[argv_current];
 
-            char *endptr = NULL;
-            long int_val = strtol(argv[argv_current], &endptr, 0);
-            if (endptr == argv[argv_current])
+            long int_val = 0;
+            bool is_numeric = false;
+            if (NULL != args)
+            {
+                int_val = args[argv_current].int_val;
+                is_numeric =
+                    (0 != (args[argv_current].flags & CPARAM_ARG_NUMERIC));
+            }
+            else
+            {
+                const char * endptr = NULL;
+                int_val = cparam_strtol(argv[argv_current], &endptr);
+                is_numeric = (endptr != argv[argv_current]);
+            }
+            if (!is_numeric)
             {
                 /* No integer found. */
-                if (NULL != err_msg)
-                {
-                    snprintf(err_msg, err_msg_size,
-                        "Not a valid integer: \"%s\"",
-                        argv[argv_current]
-                    );
-                }
+                cparam_fail(err_msg, err_msg_size,
+                    CPARAM_MSG_NOT_INTEGER,
+                    argv[argv_current]
+                );
                 return false;
             }
             if (param->has_range)
@@ -76,15 +459,12 @@ cparam_process_arg(
                 if ( (int_val < param->int_val_min)
                   || (int_val > param->int_val_max) )
                 {
-                    if (NULL != err_msg)
-                    {
-                        snprintf(err_msg, err_msg_size,
-                "Specified value %ld is not between %d and %d (inclusive).",
-                            int_val,
-                            param->int_val_min,
-                            param->int_val_max
-                        );
-                    }
+                    cparam_fail(err_msg, err_msg_size,
+                        CPARAM_MSG_OUT_OF_RANGE,
+                        int_val,
+                        param->int_val_min,
+                        param->int_val_max
+                    );
                     return false;
                 }
             }
@@ -94,329 +474,1237 @@ cparam_process_arg(
     case CPARAM_KEYWORD:
         {
             param->str_val = argv[argv_current];
+            const size_t arg_len = cparam_arg_len(argv, args, argv_current);
 
             /* Find which keyword in list matches. */
             int key_idx = 0;
-            const int key_lim = param->key_lim;
-            const struct cparam_keyword_info * matching_key = NULL;
-
-            // Partial matches okay if unique. Count number of matches, if
-            // one then found the keyword.
-            int num_matches = 0;
-            for (key_idx = 0;key_idx < key_lim;key_idx++)
-            {
-                const struct cparam_keyword_info * const current_key =
-                    &param->key_list[key_idx];
-                // Only compare to length of parameter for partial matches.
-                if (0 == strncmp(
-                        current_key->name,
-                        argv[argv_current],
-                        strlen(argv[argv_current])
-                    )
-                ) {
-                    num_matches++;
-                    matching_key = current_key;
-                    break;
-                }
-            }
+            const int num_matches = cparam_keyword_match(
+                param, argv[argv_current], arg_len, &key_idx
+            );
             if (1 != num_matches)
             {
-                if (NULL != err_msg)
+                const int msg_len = cparam_fail(err_msg, err_msg_size,
+                    (0 == num_matches)
+                        ? CPARAM_MSG_KEYWORD_UNKNOWN
+                        : CPARAM_MSG_KEYWORD_AMBIGUOUS,
+                    argv[argv_current]
+                );
+                if ( (0 == num_matches)
+                  && (msg_len > 0)
+                  && ((size_t)msg_len < err_msg_size) )
                 {
-                    snprintf(err_msg, err_msg_size,
-                        "Keyword \"%s\" %s.",
+                    cparam_suggest(
+                        param,
                         argv[argv_current],
-                        (0 == num_matches)
-                            ? "is not in the keyword list"
-                            : "matches too many keywords"
+                        arg_len,
+                        err_msg + msg_len,
+                        err_msg_size - msg_len
                     );
                 }
                 return false;
             }
             param->key_idx = key_idx;
-            param->int_val = matching_key->val;
+            param->int_val = param->key_list[key_idx].val;
         }
         break;
     case CPARAM_ACTION:
-        // Doesn't parse anything.
+    case CPARAM_KEYVAL:
+        // Handled above.
         break;
     }
+    *arg_cnt = 1;
     return true;
 }
 
-bool
-cparam_process(
+static bool
+cparam_process_keyval(
     const int argc,
     const char * const argv[],
-    int * argv_idx, // argv position to start, updated to last one parsed.
-    struct cparam_info * const start_param,
+    const struct cparam_arg * const args,
+    const int argv_current,
+    struct cparam_info * const param,
     char * const err_msg,
-    const size_t err_msg_size
+    const size_t err_msg_size,
+    int * const arg_cnt
 ) {
-    int argv_current = (NULL != argv_idx) ? *argv_idx : 0;
-    if ((NULL == argv) || (NULL == start_param))
+    param->str_val = (argv_current < argc) ? argv[argv_current] : NULL;
+    param->key_seen = 0;
+    int arg_idx = argv_current;
+    while (arg_idx < argc)
     {
-        if (NULL != argv_idx)
+        const char * const arg = argv[arg_idx];
+        const char * equals = NULL;
+        size_t key_len = 0;
+        if (NULL != args)
         {
-            *argv_idx = argv_current;
+            key_len = args[arg_idx].key_len;
+            if (0 != (args[arg_idx].flags & CPARAM_ARG_HAS_EQUALS))
+            {
+                equals = arg + key_len;
+            }
         }
-        if (NULL != err_msg)
+        else
         {
-            snprintf(
-                err_msg, err_msg_size,
-                "%s called with NULL %s%s%s parameter.",
-                __func__,
-                (NULL == argv) ? "argv" : "",
-                ((NULL == argv) && (NULL == start_param)) ? ", " : "",
-                (NULL == start_param) ? "start_param" : ""
+            equals = strchr(arg, '=');
+            key_len = (NULL != equals) ? (size_t)(equals - arg) : strlen(arg);
+        }
+        *arg_cnt = arg_idx - argv_current;
+        if (0 == key_len)
+        {
+            /* An empty key would match the start of every key. */
+            if (NULL == equals)
+            {
+                break;
+            }
+            cparam_fail(err_msg, err_msg_size,
+                CPARAM_MSG_KEY_UNKNOWN, 0, arg
             );
+            return false;
         }
-        return false;
-    }
-    struct cparam_info * param = start_param;
 
-    for (;;)
-    {
-        if ( !cparam_process_arg(
-                argc, argv, argv_current, param, err_msg, err_msg_size
-            )
-        ) {
-            if (NULL != argv_idx)
+        int key_idx = 0;
+        const int num_matches =
+            cparam_keyword_match(param, arg, key_len, &key_idx);
+        if ( (NULL == equals)
+          && ( (1 != num_matches)
+            || ('\0' != param->key_list[key_idx].name[key_len]) ) )
+        {
+            /* Without "=" only a whole key name is a key, anything else is
+               for whatever follows. */
+            break;
+        }
+        if (1 != num_matches)
+        {
+            const int msg_len = cparam_fail(err_msg, err_msg_size,
+                (0 == num_matches)
+                    ? CPARAM_MSG_KEY_UNKNOWN
+                    : CPARAM_MSG_KEY_AMBIGUOUS,
+                (int)key_len, arg
+            );
+            if ( (0 == num_matches)
+              && (msg_len > 0)
+              && ((size_t)msg_len < err_msg_size) )
             {
-                *argv_idx = argv_current;
+                cparam_suggest(
+                    param,
+                    arg, key_len,
+                    err_msg + msg_len,
+                    err_msg_size - msg_len
+                );
             }
             return false;
         }
-        if (NULL != param->action)
+        const struct cparam_keyword_info * const key =
+            &param->key_list[key_idx];
+        if (key_idx >= 64)
         {
-            if ( !param->action(
-                    start_param, param->action_data, err_msg, err_msg_size
-                )
-            ) {
-                if (NULL != argv_idx)
-                {
-                    *argv_idx = argv_current;
-                }
+            cparam_fail(err_msg, err_msg_size,
+                CPARAM_MSG_KEY_PAST_MAX, key->name
+            );
+            return false;
+        }
+        if (0 != (param->key_seen & CPARAM_KEY_BIT(key_idx)))
+        {
+            cparam_fail(err_msg, err_msg_size,
+                CPARAM_MSG_KEY_REPEATED, key->name
+            );
+            return false;
+        }
+        param->key_seen |= CPARAM_KEY_BIT(key_idx);
+        arg_idx++;
+
+        if (NULL == key->next_param)
+        {
+            /* Flag, no value. */
+            if (NULL != equals)
+            {
+                cparam_fail(err_msg, err_msg_size,
+                    CPARAM_MSG_KEY_NO_VALUE, key->name
+                );
                 return false;
             }
+            continue;
         }
-        /* Param is processed, so cparam_next works now. */
-        param = cparam_next(param);
-        if (NULL == param)
+
+        /* Value is either after the "=", or the next argument. The part
+           after "=" wasn't scanned on its own, so it has no cparam_arg. */
+        const char * value_argv[1];
+        const struct cparam_arg * value_args = NULL;
+        if (NULL != equals)
         {
-            /* End of the line. */
-            /* If you wanted to be strict, you could return false if there were
-               unused arguments (argv_current < argc - 1). */
-            if (NULL != argv_idx)
+            value_argv[0] = equals + 1;
+        }
+        else if (arg_idx < argc)
+        {
+            value_argv[0] = argv[arg_idx];
+            if (NULL != args)
             {
-                *argv_idx = argv_current;
+                value_args = &args[arg_idx];
             }
-            return true;
+            *arg_cnt = arg_idx - argv_current;
+            arg_idx++;
+        }
+        else
+        {
+            cparam_fail(err_msg, err_msg_size,
+                CPARAM_MSG_KEY_MISSING_VALUE, key->name
+            );
+            return false;
+        }
+        if ( (CPARAM_KEYVAL == key->next_param->type)
+          || (CPARAM_ACTION == key->next_param->type) )
+        {
+            cparam_fail(err_msg, err_msg_size,
+                CPARAM_MSG_KEY_BAD_VALUE_TYPE, key->name
+            );
+            return false;
+        }
+        int value_cnt = 0;
+        if ( !cparam_process_arg(
+                1, value_argv, value_args, 0,
+                key->next_param,
+                err_msg, err_msg_size,
+                &value_cnt
+            )
+        ) {
+            return false;
         }
-        argv_current++;
     }
-}
+    *arg_cnt = arg_idx - argv_current;
 
-static void
-cparam_indent(const unsigned int indent_level)
-{
-    for (unsigned int indent_cnt = 0;indent_cnt < indent_level;indent_cnt++)
+    const uint64_t key_missing = param->key_required & ~param->key_seen;
+    if (0 != key_missing)
     {
-        printf("  ");
+        unsigned int key_idx = 0;
+        while (0 == (key_missing & CPARAM_KEY_BIT(key_idx)))
+        {
+            key_idx++;
+        }
+        cparam_fail(err_msg, err_msg_size,
+            CPARAM_MSG_KEY_MISSING, param->key_list[key_idx].name
+        );
+        return false;
     }
+    return true;
 }
 
-static bool
-cparam_has_more_lines(
-    const struct cparam_info * const start_param
+static void
+cparam_cache_record_node(
+    struct cparam_cache_entry * const record,
+    unsigned int * const node_lim,
+    struct cparam_info * const param,
+    const int argv_offset,
+    const int arg_cnt,
+    const int str_offset,
+    const bool is_key_value
 ) {
-    for ( const struct cparam_info * param = start_param;
-        NULL != param;
-        param = param->next_param )
+    if (*node_lim < CPARAM_CACHE_NODE_MAX)
     {
-        if ((NULL != param->desc) && ('\0' != param->desc[0])) {
-            // Has a description.
-            return true;
-        }
-        if (CPARAM_KEYWORD == param->type)
-        {
-            // Has keyword in list.
-            return true;
-        }
+        struct cparam_cache_node * const node = &record->nodes[*node_lim];
+        node->param = param;
+        node->argv_offset = argv_offset;
+        node->arg_cnt = arg_cnt;
+        node->str_offset = str_offset;
+        node->is_key_value = is_key_value;
+        node->int_val = param->int_val;
+        node->key_idx = param->key_idx;
+        node->key_seen = param->key_seen;
     }
-    return false;
+    (*node_lim)++;
 }
 
+/*
+    Save a parsed parameter in a cache entry. For CPARAM_KEYVAL, the values
+    are saved after it.
+ */
 static void
-cparam_print_parameters(
-    const struct cparam_info * const start_param,
-    unsigned int indent_level
+cparam_cache_record(
+    struct cparam_cache_entry * const record,
+    unsigned int * const node_lim,
+    struct cparam_info * const param,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int argv_start,
+    const int argv_current,
+    const int arg_cnt
 ) {
-    /* First list the paramers. */
-    for ( const struct cparam_info * param = start_param;
-        NULL != param;
-        param = param->next_param )
+    cparam_cache_record_node(
+        record, node_lim, param,
+        (arg_cnt > 0) ? argv_current - argv_start : -1,
+        arg_cnt,
+        0, false
+    );
+    if (CPARAM_KEYVAL != param->type)
     {
-        const bool has_name = (NULL != param->name) && ('\0' != param->name[0]);
-        const char * const name = has_name ? param->name : "";
-        const char * const sep = has_name ? ":" : "";
-
-        switch (param->type)
+        return;
+    }
+    for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+    {
+        struct cparam_info * const value_param =
+            param->key_list[key_idx].next_param;
+        if ( (0 == (param->key_seen & CPARAM_KEY_BIT(key_idx)))
+          || (NULL == value_param) )
         {
-        case CPARAM_STRING:
-            printf("<%s%sstring> ", name, sep);
-            break;
-        case CPARAM_INT:
-            if (param->has_range)
+            continue;
+        }
+        /* Value is all or part (after "=") of one of the arguments. */
+        for (int arg_idx = argv_current;
+            arg_idx < argv_current + arg_cnt;
+            arg_idx++)
+        {
+            const char * const arg = argv[arg_idx];
+            if ( (value_param->str_val >= arg)
+              && ( value_param->str_val
+                <= arg + cparam_arg_len(argv, args, arg_idx) ) )
             {
-                printf("<%s%s%d-%d> ",
-                    name, sep, param->int_val_min, param->int_val_max
+                cparam_cache_record_node(
+                    record, node_lim, value_param,
+                    arg_idx - argv_start, 1,
+                    value_param->str_val - arg,
+                    true
                 );
+                break;
             }
-            else
-            {
-                printf("<%s%sinteger> ", name, sep);
-            }
-            break;
-        case CPARAM_KEYWORD:
-            if (has_name)
-            {
-                printf("<%s> ", name);
+        }
+    }
+}
+
+/*
+    Parse arguments starting at *argv_idx. If record is not NULL, the path
+    taken is saved in it so it can be used by the cache. If replay is not NULL,
+    it says whether actions are run. If arg_lim is not NULL, it's set to the
+    number of arguments used, which argv_idx can't tell apart from one when
+    nothing was used.
+ */
+static bool
+cparam_process_main(
+    const int argc,
+    const char * const argv[],
+    const struct cparam_arg * const args, // NULL if argv wasn't scanned.
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size,
+    struct cparam_cache_entry * const record,
+    const struct cparam_replay * const replay,
+    int * const arg_lim
+) {
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    if ((NULL == argv) || (NULL == start_param))
+    {
+        cparam_fail(err_msg, err_msg_size,
+            CPARAM_MSG_NULL_PARAMETER,
+            "cparam_process",
+            (NULL == argv) ? "argv" : "",
+            ((NULL == argv) && (NULL == start_param)) ? ", " : "",
+            (NULL == start_param) ? "start_param" : ""
+        );
+        return false;
+    }
+    struct cparam_info * param = start_param;
+    // Next argument to parse.
+    int argv_current = argv_start;
+    // Last argument parsed, before the start if none yet.
+    int argv_last = argv_start - 1;
+    unsigned int node_lim = 0;
+    // Argument after the last CPARAM_KEYVAL, which it read to find its end.
+    int keyval_end = -1;
+
+    for (;;)
+    {
+        CPARAM_TRACE_BEGIN(arg_start_ns);
+        int arg_cnt = 0;
+        const bool arg_ok = cparam_process_arg(
+            argc, argv, args, argv_current,
+            param, err_msg, err_msg_size, &arg_cnt
+        );
+        CPARAM_TRACE_END(arg_start_ns, "process_arg", param->name);
+        if (!arg_ok)
+        {
+            if (NULL != argv_idx)
+            {
+                *argv_idx = argv_current + arg_cnt;
             }
-            else
+            return false;
+        }
+        if (NULL != record)
+        {
+            cparam_cache_record(
+                record, &node_lim, param,
+                argv, args, argv_start, argv_current, arg_cnt
+            );
+            if (CPARAM_KEYVAL == param->type)
             {
-                printf("<keyword> ");
+                keyval_end = argv_current + arg_cnt;
             }
+        }
+        // Action parameter does not use an argument, so the next parameter
+        // gets the same one.
+        if (arg_cnt > 0)
+        {
+            argv_current += arg_cnt;
+            argv_last = argv_current - 1;
+        }
+        cparam_action action = param->action;
+        void * action_data = param->action_data;
+        if ((NULL != action) && (NULL != replay) && !replay->run_actions)
+        {
+            action = replay->action_stub;
+            action_data = replay->stub_data;
+        }
+        if (NULL != action)
+        {
+            CPARAM_TRACE_BEGIN(action_start_ns);
+            const bool action_ok = action(
+                start_param, action_data, err_msg, err_msg_size
+            );
+            CPARAM_TRACE_END(action_start_ns, "action", param->name);
+            if (!action_ok)
+            {
+                cparam_error_id = CPARAM_MSG_ACTION_FAILED;
+                if (NULL != argv_idx)
+                {
+                    *argv_idx =
+                        (argv_last >= argv_start) ? argv_last : argv_start;
+                }
+                return false;
+            }
+        }
+        /* Param is processed, so cparam_next works now. */
+        param = cparam_next(param);
+        if (NULL == param)
+        {
+            /* End of the line. */
+            /* If you wanted to be strict, you could return false if there were
+               unused arguments (argv_last < argc - 1). */
+            if (NULL != argv_idx)
+            {
+                *argv_idx =
+                    (argv_last >= argv_start) ? argv_last : argv_start;
+            }
+            if (NULL != record)
+            {
+                record->node_lim = node_lim;
+                record->arg_lim = argv_current - argv_start;
+                /* Only if nothing after the list used that argument. */
+                record->peek = CPARAM_CACHE_PEEK_NONE;
+                if (keyval_end == argv_current)
+                {
+                    record->peek = (argv_current < argc)
+                        ? CPARAM_CACHE_PEEK_ARG
+                        : CPARAM_CACHE_PEEK_END;
+                }
+            }
+            if (NULL != arg_lim)
+            {
+                *arg_lim = argv_current - argv_start;
+            }
+            return true;
+        }
+    }
+}
+
+/*
+    After one of the public process functions, add the parse to the capture if
+    there is one. Not with CPARAM_REALTIME, since writing it is a system call
+    and hashing the result uses stdio.
+ */
+#ifdef CPARAM_REALTIME
+#define cparam_process_done(ok, argc, argv, argv_start, argv_idx, start_param) \
+    ((void)(argv_start), (ok))
+#else
+static bool
+cparam_process_done(
+    const bool ok,
+    const int argc,
+    const char * const argv[],
+    const int argv_start,
+    const int * const argv_idx,
+    const struct cparam_info * const start_param
+) {
+    if ( NULL == atomic_load_explicit(
+            &cparam_capture_current, memory_order_relaxed
+        )
+    ) {
+        return ok;
+    }
+    atomic_fetch_add(&cparam_capture_users, 1);
+    struct cparam_capture * const capture =
+        atomic_load(&cparam_capture_current);
+    if (NULL != capture)
+    {
+        cparam_capture_add(
+            capture, argc, argv, argv_start, argv_idx, ok, start_param
+        );
+    }
+    atomic_fetch_sub(&cparam_capture_users, 1);
+    return ok;
+}
+#endif
+
+bool
+cparam_process(
+    const int argc,
+    const char * const argv[],
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    const bool ok = cparam_process_main(
+        argc, argv, NULL, argv_idx, start_param, err_msg, err_msg_size,
+        NULL, NULL, NULL
+    );
+    return cparam_process_done(
+        ok, argc, argv, argv_start, argv_idx, start_param
+    );
+}
+
+bool
+cparam_process_used(
+    const int argc,
+    const char * const argv[],
+    int * argv_idx,
+    struct cparam_info * const start_param,
+    int * const arg_lim,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    const bool ok = cparam_process_main(
+        argc, argv, NULL, argv_idx, start_param, err_msg, err_msg_size,
+        NULL, NULL, arg_lim
+    );
+    return cparam_process_done(
+        ok, argc, argv, argv_start, argv_idx, start_param
+    );
+}
+
+bool
+cparam_process_replay(
+    const int argc,
+    const char * const argv[],
+    int * argv_idx,
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size,
+    const struct cparam_replay * const replay
+) {
+    return cparam_process_main(
+        argc, argv, NULL, argv_idx, start_param, err_msg, err_msg_size,
+        NULL, replay, NULL
+    );
+}
+
+/*
+    FNV-1a of str. The terminating NUL is included so that argument boundaries
+    are part of a hash of several arguments. If len is not NULL, it's set to
+    the length of str, and if key_len is not NULL, to the length up to the
+    first "=", or the whole length if there isn't one.
+ */
+static uint64_t
+cparam_hash_str(
+    const char * const str,
+    size_t * const len,
+    size_t * const key_len
+) {
+    const unsigned char * str_ptr = (const unsigned char *)str;
+    const unsigned char * equals = NULL;
+    uint64_t hash = CPARAM_FNV_OFFSET;
+    for (;;)
+    {
+        hash ^= *str_ptr;
+        hash *= CPARAM_FNV_PRIME;
+        if ('\0' == *str_ptr)
+        {
             break;
-        case CPARAM_ACTION:
-            // No corresponding argument.
-            break;
         }
+        if (('=' == *str_ptr) && (NULL == equals))
+        {
+            equals = str_ptr;
+        }
+        str_ptr++;
     }
+    if (NULL != len)
+    {
+        *len = str_ptr - (const unsigned char *)str;
+    }
+    if (NULL != key_len)
+    {
+        *key_len = (NULL != equals ? equals : str_ptr)
+            - (const unsigned char *)str;
+    }
+    return hash;
 }
 
-static void
-cparam_print_main(
+void
+cparam_argv_scan(struct cparam_argv * const argv_desc)
+{
+    for (int arg_idx = 0;arg_idx < argv_desc->argc;arg_idx++)
+    {
+        const char * const str = argv_desc->argv[arg_idx];
+        struct cparam_arg * const arg = &argv_desc->args[arg_idx];
+        arg->hash = cparam_hash_str(str, &arg->len, &arg->key_len);
+        arg->flags = 0;
+        if (arg->key_len < arg->len)
+        {
+            arg->flags |= CPARAM_ARG_HAS_EQUALS;
+        }
+        const char * endptr = NULL;
+        arg->int_val = cparam_strtol(str, &endptr);
+        if (endptr != str)
+        {
+            arg->flags |= CPARAM_ARG_NUMERIC;
+        }
+        else if ('-' == str[0])
+        {
+            arg->flags |= CPARAM_ARG_OPTION;
+        }
+    }
+}
+
+bool
+cparam_process_argv(
+    const struct cparam_argv * const argv_desc,
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    if (NULL == argv_desc)
+    {
+        // Reports the NULL argv.
+        return cparam_process(0, NULL, argv_idx, start_param,
+            err_msg, err_msg_size
+        );
+    }
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    const bool ok = cparam_process_main(
+        argv_desc->argc, argv_desc->argv, argv_desc->args,
+        argv_idx, start_param, err_msg, err_msg_size, NULL, NULL, NULL
+    );
+    return cparam_process_done(
+        ok, argv_desc->argc, argv_desc->argv, argv_start, argv_idx, start_param
+    );
+}
+
+static uint64_t
+cparam_cache_hash_start(const struct cparam_info * const start_param)
+{
+    return (CPARAM_FNV_OFFSET ^ (uintptr_t)start_param) * CPARAM_FNV_PRIME;
+}
+
+/*
+    Add argv[arg_idx] to the hash of the arguments before it. Each argument is
+    hashed on its own, so that hashes from cparam_argv_scan() can be used.
+ */
+static uint64_t
+cparam_cache_hash_arg(
+    const uint64_t hash,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int arg_idx
+) {
+    const uint64_t arg_hash = (NULL != args)
+        ? args[arg_idx].hash
+        : cparam_hash_str(argv[arg_idx], NULL, NULL);
+    return (hash ^ arg_hash) * CPARAM_FNV_PRIME;
+}
+
+void
+cparam_cache_clear(struct cparam_cache * const cache)
+{
+    for (unsigned int entry_idx = 0;entry_idx < cache->entry_lim;entry_idx++)
+    {
+        cache->entries[entry_idx].start_param = NULL;
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+/* Hash for a parse that used all the arguments and found no more. */
+static uint64_t
+cparam_cache_hash_end(const uint64_t hash)
+{
+    // Any change will do, entries are checked.
+    return (hash ^ CPARAM_FNV_OFFSET) * CPARAM_FNV_PRIME;
+}
+
+/* Arguments stored in an entry, including one it peeked at. */
+static unsigned int
+cparam_cache_stored_lim(const struct cparam_cache_entry * const entry)
+{
+    return entry->arg_lim + ((CPARAM_CACHE_PEEK_ARG == entry->peek) ? 1 : 0);
+}
+
+/*
+    The entry for hash, if it is for start_param in this generation, stored
+    the arg_cnt arguments at argv_start, and ended at the end of argv or not as
+    at_end says.
+ */
+static const struct cparam_cache_entry *
+cparam_cache_match(
+    const struct cparam_cache * const cache,
+    const uint64_t hash,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int argv_start,
+    const unsigned int arg_cnt,
+    const bool at_end,
     const struct cparam_info * const start_param,
-    unsigned int indent_level
+    const unsigned long generation
 ) {
-    if (!cparam_has_more_lines(start_param)) {
+    const struct cparam_cache_entry * const entry =
+        &cache->entries[hash % cache->entry_lim];
+    if ( (entry->hash != hash)
+      || (entry->start_param != start_param)
+      || (entry->generation != generation)
+      || (cparam_cache_stored_lim(entry) != arg_cnt)
+      || ((CPARAM_CACHE_PEEK_END == entry->peek) != at_end) )
+    {
+        return NULL;
+    }
+    /* Hash matches, check the arguments really are the same. Stored arguments
+       can be shorter, so strcmp() to stop at their end. */
+    const char * args_ptr = entry->args;
+    for (unsigned int arg_idx = 0;arg_idx < arg_cnt;arg_idx++)
+    {
+        if (0 != strcmp(args_ptr, argv[argv_start + arg_idx]))
+        {
+            return NULL;
+        }
+        args_ptr += cparam_arg_len(argv, args, argv_start + arg_idx) + 1;
+    }
+    return entry;
+}
+
+/*
+    Find an entry for the arguments starting at argv_start. The number of
+    arguments a parse uses isn't known until it's done, so every possible count
+    is tried. The parse is decided by the arguments it uses, and for one ending
+    in a CPARAM_KEYVAL list, by the next argument or there being none, which the
+    entry stores too. So any entry with the same arguments has the right result.
+ */
+static const struct cparam_cache_entry *
+cparam_cache_find(
+    const struct cparam_cache * const cache,
+    const int argc,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int argv_start,
+    const struct cparam_info * const start_param,
+    const unsigned long generation
+) {
+    uint64_t hash = cparam_cache_hash_start(start_param);
+    for (unsigned int arg_cnt = 0;;arg_cnt++)
+    {
+        const struct cparam_cache_entry * entry = cparam_cache_match(
+            cache, hash, argv, args, argv_start, arg_cnt, false,
+            start_param, generation
+        );
+        if (NULL != entry)
+        {
+            return entry;
+        }
+        if (argv_start + (int)arg_cnt >= argc)
+        {
+            return cparam_cache_match(
+                cache, cparam_cache_hash_end(hash),
+                argv, args, argv_start, arg_cnt, true,
+                start_param, generation
+            );
+        }
+        if (arg_cnt >= CPARAM_CACHE_NODE_MAX)
+        {
+            return NULL;
+        }
+        hash = cparam_cache_hash_arg(hash, argv, args, argv_start + arg_cnt);
+    }
+}
+
+static void
+cparam_cache_insert(
+    struct cparam_cache * const cache,
+    const char * const argv[],
+    const struct cparam_arg * const args,
+    const int argv_start,
+    struct cparam_info * const start_param,
+    const unsigned long generation,
+    const struct cparam_cache_entry * const record
+) {
+    /* cparam_cache_find() doesn't look past CPARAM_CACHE_NODE_MAX arguments,
+       so an entry with more would never be found. */
+    const unsigned int stored_lim = cparam_cache_stored_lim(record);
+    if ( (record->node_lim > CPARAM_CACHE_NODE_MAX)
+      || (stored_lim > CPARAM_CACHE_NODE_MAX) )
+    {
         return;
     }
-    for ( const struct cparam_info * param = start_param;
-        NULL != param;
-        param = param->next_param )
+    uint64_t hash = cparam_cache_hash_start(start_param);
+    size_t args_len = 0;
+    for (unsigned int arg_cnt = 0;arg_cnt < stored_lim;arg_cnt++)
+    {
+        const int arg_idx = argv_start + arg_cnt;
+        hash = cparam_cache_hash_arg(hash, argv, args, arg_idx);
+        args_len += cparam_arg_len(argv, args, arg_idx) + 1;
+    }
+    if (CPARAM_CACHE_PEEK_END == record->peek)
+    {
+        hash = cparam_cache_hash_end(hash);
+    }
+    if (args_len > CPARAM_CACHE_ARGS_SIZE)
+    {
+        return;
+    }
+    struct cparam_cache_entry * const entry =
+        &cache->entries[hash % cache->entry_lim];
+    memcpy(entry->nodes, record->nodes,
+        record->node_lim * sizeof(entry->nodes[0])
+    );
+    char * args_ptr = entry->args;
+    for (unsigned int arg_cnt = 0;arg_cnt < stored_lim;arg_cnt++)
+    {
+        const int arg_idx = argv_start + arg_cnt;
+        const size_t arg_size = cparam_arg_len(argv, args, arg_idx) + 1;
+        memcpy(args_ptr, argv[arg_idx], arg_size);
+        args_ptr += arg_size;
+    }
+    entry->hash = hash;
+    entry->start_param = start_param;
+    entry->generation = generation;
+    entry->node_lim = record->node_lim;
+    entry->arg_lim = record->arg_lim;
+    entry->peek = record->peek;
+}
+
+static bool
+cparam_process_cached_main(
+    struct cparam_cache * const cache,
+    const int argc,
+    const char * const argv[],
+    const struct cparam_arg * const args, // NULL if argv wasn't scanned.
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    if ( (NULL == cache) || (0 == cache->entry_lim)
+      || (NULL == argv) || (NULL == start_param) )
+    {
+        return cparam_process_main(
+            argc, argv, args, argv_idx, start_param,
+            err_msg, err_msg_size, NULL, NULL, NULL
+        );
+    }
+    /* After the caller got start_param from the grammar, so a grammar
+       published since then is in a later generation. */
+    const unsigned long generation = (NULL != cache->grammar)
+        ? atomic_load_explicit(
+            &cache->grammar->generation, memory_order_acquire
+        )
+        : 0;
+    const struct cparam_cache_entry * const entry = cparam_cache_find(
+        cache, argc, argv, args, argv_start, start_param, generation
+    );
+    if (NULL == entry)
+    {
+        cache->misses++;
+        struct cparam_cache_entry record;
+        if ( !cparam_process_main(
+                argc, argv, args, argv_idx, start_param,
+                err_msg, err_msg_size,
+                &record, NULL, NULL
+            )
+        ) {
+            return false;
+        }
+        cparam_cache_insert(
+            cache, argv, args, argv_start, start_param, generation, &record
+        );
+        return true;
+    }
+    cache->hits++;
+
+    /* Put back the parsed values first, so that cparam_next() works for any
+       action. */
+    for (unsigned int node_idx = 0;node_idx < entry->node_lim;node_idx++)
     {
-        const bool has_desc =
-            (NULL != param->desc) && ('\0' != param->desc[0]);
-        if (has_desc || (CPARAM_KEYWORD == param->type))
+        const struct cparam_cache_node * const node = &entry->nodes[node_idx];
+        struct cparam_info * const param = node->param;
+        if (node->argv_offset >= 0)
         {
-            const bool has_name =
-                (NULL != param->name) && ('\0' != param->name[0]);
-            /* Print name first. */
-            const char * name = "";
-            if (has_name)
-            {
-                name = param->name;
-            }
-            else
+            param->str_val =
+                argv[argv_start + node->argv_offset] + node->str_offset;
+        }
+        else if (CPARAM_KEYVAL == param->type)
+        {
+            param->str_val = NULL;
+        }
+        param->int_val = node->int_val;
+        param->key_idx = node->key_idx;
+        param->key_seen = node->key_seen;
+    }
+    int argv_last = argv_start - 1;
+    for (unsigned int node_idx = 0;node_idx < entry->node_lim;node_idx++)
+    {
+        const struct cparam_cache_node * const node = &entry->nodes[node_idx];
+        const struct cparam_info * const param = node->param;
+        if (node->is_key_value)
+        {
+            // Only for the value, the CPARAM_KEYVAL has the action.
+            continue;
+        }
+        if (node->arg_cnt > 0)
+        {
+            argv_last = argv_start + node->argv_offset + node->arg_cnt - 1;
+        }
+        if (NULL != param->action)
+        {
+            CPARAM_TRACE_BEGIN(action_start_ns);
+            const bool action_ok = param->action(
+                start_param, param->action_data, err_msg, err_msg_size
+            );
+            CPARAM_TRACE_END(action_start_ns, "action", param->name);
+            if (!action_ok)
             {
-                switch (param->type)
+                cparam_error_id = CPARAM_MSG_ACTION_FAILED;
+                if (NULL != argv_idx)
                 {
-                case CPARAM_STRING:
-                    name = "string";
-                    break;
-                case CPARAM_INT:
-                    name = "integer";
-                    break;
-                case CPARAM_KEYWORD:
-                    name = "keyword";
-                    break;
-                case CPARAM_ACTION:
-                    // Shouldn't get here
-                    break;
+                    *argv_idx =
+                        (argv_last >= argv_start) ? argv_last : argv_start;
                 }
+                return false;
             }
-            cparam_indent(indent_level + 1);
-            if (param->has_range)
+        }
+    }
+    if (NULL != argv_idx)
+    {
+        *argv_idx = (entry->arg_lim > 0)
+            ? argv_start + (int)entry->arg_lim - 1
+            : argv_start;
+    }
+    return true;
+}
+
+bool
+cparam_process_cached(
+    struct cparam_cache * const cache,
+    const int argc,
+    const char * const argv[],
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    const bool ok = cparam_process_cached_main(
+        cache, argc, argv, NULL, argv_idx, start_param, err_msg, err_msg_size
+    );
+    return cparam_process_done(
+        ok, argc, argv, argv_start, argv_idx, start_param
+    );
+}
+
+bool
+cparam_process_cached_argv(
+    struct cparam_cache * const cache,
+    const struct cparam_argv * const argv_desc,
+    int * argv_idx, // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    if (NULL == argv_desc)
+    {
+        // Reports the NULL argv.
+        return cparam_process(0, NULL, argv_idx, start_param,
+            err_msg, err_msg_size
+        );
+    }
+    const int argv_start = (NULL != argv_idx) ? *argv_idx : 0;
+    const bool ok = cparam_process_cached_main(
+        cache, argv_desc->argc, argv_desc->argv, argv_desc->args,
+        argv_idx, start_param, err_msg, err_msg_size
+    );
+    return cparam_process_done(
+        ok, argv_desc->argc, argv_desc->argv, argv_start, argv_idx, start_param
+    );
+}
+
+/*
+    Append to a canonical form buffer, counting the full length even when it
+    doesn't fit.
+ */
+static void
+cparam_canonical_append(
+    char * const buf,
+    const size_t buf_size,
+    size_t * const buf_len,
+    const char * const str,
+    const size_t str_len
+) {
+    if (*buf_len < buf_size)
+    {
+        const size_t space = buf_size - *buf_len - 1;
+        memcpy(buf + *buf_len, str, (str_len < space) ? str_len : space);
+    }
+    *buf_len += str_len;
+}
+
+/* Decimal form of val, without stdio. Returns the length. */
+static size_t
+cparam_int_str(const int val, char str[16])
+{
+    char digits[16];
+    size_t digit_lim = 0;
+    unsigned int digit_val =
+        (val < 0) ? 0u - (unsigned int)val : (unsigned int)val;
+    do
+    {
+        digits[digit_lim++] = '0' + digit_val % 10;
+        digit_val /= 10;
+    } while (0 != digit_val);
+    size_t str_len = 0;
+    if (val < 0)
+    {
+        str[str_len++] = '-';
+    }
+    while (digit_lim > 0)
+    {
+        str[str_len++] = digits[--digit_lim];
+    }
+    return str_len;
+}
+
+/* Append "key_name=", if there's a key name. */
+static void
+cparam_canonical_key(
+    const char * const key_name,
+    char * const buf,
+    const size_t buf_size,
+    size_t * const buf_len
+) {
+    if (NULL != key_name)
+    {
+        cparam_canonical_append(
+            buf, buf_size, buf_len, key_name, strlen(key_name)
+        );
+        cparam_canonical_append(buf, buf_size, buf_len, "=", 1);
+    }
+}
+
+/*
+    Append the canonical form of one parsed parameter, after a space if there's
+    something before it. For the value of a key, key_name and "=" go before the
+    value, inside any quotes. A CPARAM_KEYVAL adds no space of its own, only
+    one before each key, so a list with no keys adds nothing.
+ */
+static void
+cparam_canonical_param(
+    const struct cparam_info * const param,
+    const char * const key_name, // NULL if not the value of a key.
+    char * const buf,
+    const size_t buf_size,
+    size_t * const buf_len
+) {
+    if ( (CPARAM_ACTION != param->type)
+      && (CPARAM_KEYVAL != param->type)
+      && (*buf_len > 0) )
+    {
+        cparam_canonical_append(buf, buf_size, buf_len, " ", 1);
+    }
+    switch (param->type)
+    {
+    case CPARAM_STRING:
+    case CPARAM_PATTERN:
+        {
+            const char * const str = param->str_val;
+            const bool needs_quotes = ('\0' == str[0])
+                || ('\0' != str[strcspn(str, " \t\n\"\\")]);
+            if (needs_quotes)
             {
-                if (has_name)
-                {
-                    printf("<%s:%d-%d>:",
-                        name, param->int_val_min, param->int_val_max
-                    );
-                }
-                else
+                cparam_canonical_append(buf, buf_size, buf_len, "\"", 1);
+            }
+            cparam_canonical_key(key_name, buf, buf_size, buf_len);
+            for (const char * str_ptr = str;'\0' != *str_ptr;)
+            {
+                const size_t plain_len = strcspn(str_ptr, "\"\\");
+                cparam_canonical_append(
+                    buf, buf_size, buf_len, str_ptr, plain_len
+                );
+                str_ptr += plain_len;
+                if ('\0' != *str_ptr)
                 {
-                    printf("<%d-%d>:",
-                        param->int_val_min, param->int_val_max
-                    );
+                    cparam_canonical_append(buf, buf_size, buf_len, "\\", 1);
+                    cparam_canonical_append(buf, buf_size, buf_len, str_ptr, 1);
+                    str_ptr++;
                 }
             }
-            else
+            if (needs_quotes)
             {
-                printf("<%s>:", name);
+                cparam_canonical_append(buf, buf_size, buf_len, "\"", 1);
             }
-
-            /* Print additional information - description, keyword list. */
-            if (has_desc)
+        }
+        break;
+    case CPARAM_INT:
+        {
+            char int_str[16];
+            const size_t int_len = cparam_int_str(param->int_val, int_str);
+            cparam_canonical_key(key_name, buf, buf_size, buf_len);
+            cparam_canonical_append(buf, buf_size, buf_len, int_str, int_len);
+        }
+        break;
+    case CPARAM_KEYWORD:
+        {
+            const char * const name = param->key_list[param->key_idx].name;
+            cparam_canonical_key(key_name, buf, buf_size, buf_len);
+            cparam_canonical_append(buf, buf_size, buf_len, name, strlen(name));
+        }
+        break;
+    case CPARAM_ACTION:
+        // No corresponding argument.
+        break;
+    case CPARAM_KEYVAL:
+        /* Keys in key_list order, whatever order they were given in. */
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            if (0 == (param->key_seen & CPARAM_KEY_BIT(key_idx)))
             {
-                printf(" %s", param->desc);
+                continue;
             }
-            if (CPARAM_KEYWORD == param->type)
+            const struct cparam_keyword_info * const key =
+                &param->key_list[key_idx];
+            if (NULL == key->next_param)
             {
-                const int key_lim = param->key_lim;
-                bool has_next_param = false;
-                for (int key_idx = 0;key_idx < key_lim;key_idx++)
-                {
-                    const struct cparam_keyword_info * key =
-                        &param->key_list[key_idx];
-                    if (NULL != key->next_param)
-                    {
-                        has_next_param = true;
-                    }
-                }
-                printf(" One of: \n");
-                /* If any keyword has more parameters, print one per line,
-                   otherwise print all on one line. */
-                if (!has_next_param)
-                {
-                    cparam_indent(indent_level + 2);
-                    for (int key_idx = 0;key_idx < key_lim;key_idx++)
-                    {
-                        const struct cparam_keyword_info * key =
-                            &param->key_list[key_idx];
-                        printf("%s ", key->name);
-                    }
-                }
-                else
+                if (*buf_len > 0)
                 {
-                    for (int key_idx = 0;key_idx < key_lim;key_idx++)
-                    {
-                        const struct cparam_keyword_info * key =
-                            &param->key_list[key_idx];
-                        const struct cparam_info * const next_param =
-                            key->next_param;
-                        cparam_indent(indent_level + 2);
-                        printf("%s ", key->name);
-                        cparam_print_parameters(next_param, indent_level);
-                        printf("\n");
-                        cparam_print_main(next_param, indent_level + 2);
-                    }
+                    cparam_canonical_append(buf, buf_size, buf_len, " ", 1);
                 }
+                cparam_canonical_append(
+                    buf, buf_size, buf_len, key->name, strlen(key->name)
+                );
+            }
+            else
+            {
+                cparam_canonical_param(
+                    key->next_param, key->name, buf, buf_size, buf_len
+                );
             }
-            printf("\n");
         }
+        break;
     }
 }
 
-void
-cparam_print_param_names(const struct cparam_info * const start_param) {
-    cparam_print_parameters(start_param, 0);
+size_t
+cparam_canonical(
+    const struct cparam_info * const start_param,
+    char * const buf,
+    const size_t buf_size
+) {
+    size_t buf_len = 0;
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = cparam_next((struct cparam_info *)param) )
+    {
+        cparam_canonical_param(param, NULL, buf, buf_size, &buf_len);
+    }
+    if (buf_size > 0)
+    {
+        buf[(buf_len < buf_size) ? buf_len : buf_size - 1] = '\0';
+    }
+    return buf_len;
 }
 
-void
-cparam_print(const struct cparam_info * const start_param) {
-    cparam_print_main(start_param, 1);
+uint64_t
+cparam_result_hash(const struct cparam_info * const start_param)
+{
+    char buf[1024];
+    const size_t len = cparam_canonical(start_param, buf, sizeof(buf));
+    uint64_t hash = cparam_hash_str(buf, NULL, NULL);
+    if (len >= sizeof(buf))
+    {
+        // Didn't all fit, so at least tell different lengths apart.
+        hash = (hash ^ len) * CPARAM_FNV_PRIME;
+    }
+    return hash;
 }
 
+/* Steps for one parameter, not counting the ones after it. */
+static size_t
+cparam_steps_param(
+    const struct cparam_info * const param,
+    const size_t arg_len_max
+) {
+    // Finding the end of an argument, or comparing it to one keyword.
+    const size_t len_steps = arg_len_max + 1;
+    // A scan order halves every count once in a while, see cparam_key_order.
+    const size_t order_steps =
+        (NULL != param->key_order) ? (size_t)param->key_lim : 0;
+    const size_t key_steps =
+        len_steps + (size_t)param->key_lim * len_steps + order_steps;
+    switch (param->type)
+    {
+    case CPARAM_STRING:
+    case CPARAM_ACTION:
+        break;
+    case CPARAM_INT:
+    case CPARAM_PATTERN:
+        return 1 + 2 * len_steps;
+    case CPARAM_KEYWORD:
+        return 1 + key_steps;
+    case CPARAM_KEYVAL:
+        {
+            /* Each key at most once, then one that isn't a key. */
+            size_t steps = 1 + ((size_t)param->key_lim + 1) * key_steps;
+            for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+            {
+                const struct cparam_info * const value_param =
+                    param->key_list[key_idx].next_param;
+                if (NULL != value_param)
+                {
+                    steps += cparam_steps_param(value_param, arg_len_max);
+                }
+            }
+            return steps;
+        }
+    }
+    return 1;
+}
+
+size_t
+cparam_steps_max(
+    const struct cparam_info * const start_param,
+    const size_t arg_len_max
+) {
+    size_t steps = 0;
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        steps += cparam_steps_param(param, arg_len_max);
+        if (CPARAM_KEYWORD != param->type)
+        {
+            continue;
+        }
+        /* Whichever keyword leads to the most, see cparam_next(). */
+        const size_t next_steps =
+            cparam_steps_max(param->next_param, arg_len_max);
+        size_t key_steps_max = 0;
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            const struct cparam_info * const key_next =
+                param->key_list[key_idx].next_param;
+            const size_t key_steps = (NULL != key_next)
+                ? cparam_steps_max(key_next, arg_len_max)
+                : next_steps;
+            if (key_steps > key_steps_max)
+            {
+                key_steps_max = key_steps;
+            }
+        }
+        return steps + key_steps_max;
+    }
+    return steps;
+}
@@ -1,6 +1,8 @@
 #ifndef CPARAM_H
 #define CPARAM_H
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifndef DIM
 #define DIM(a) (sizeof(a)/sizeof(a[0]))
@@ -11,9 +13,14 @@ enum cparam_type {
     CPARAM_INT,
     CPARAM_KEYWORD,
     CPARAM_ACTION,
+    CPARAM_KEYVAL,
+    CPARAM_PATTERN,
 };
 
 struct cparam_info; /* Forward declaration. */
+struct cparam_dfa; /* Forward declaration. */
+struct cparam_key_order; /* Forward declaration. */
+struct cparam_grammar; /* Forward declaration. */
 typedef bool (*cparam_action)(
     struct cparam_info * param,
     void * data,    // May be NULL.
@@ -38,9 +45,14 @@ struct cparam_info {
     const int int_val_min;
     const int int_val_max;
 
-    // For CPARAM_KEYWORD.
+    // For CPARAM_KEYWORD and CPARAM_KEYVAL.
     const struct cparam_keyword_info * const key_list;
     const unsigned int key_lim;
+    // For CPARAM_KEYVAL, CPARAM_KEY_BIT() of each key that must be given.
+    const uint64_t key_required;
+
+    // For CPARAM_PATTERN, what the whole argument has to match.
+    const char * const pattern;
 
     // NULL if no next, or if depends on keyword.
     struct cparam_info * const next_param;
@@ -58,6 +70,17 @@ struct cparam_info {
     int int_val;
     // For CPARAM_KEYWORD, use as key_list[key_idx].
     int key_idx;
+    // For CPARAM_KEYVAL, CPARAM_KEY_BIT() of each key given.
+    uint64_t key_seen;
+
+    // Set by cparam_compile().
+    struct cparam_dfa * dfa;
+    // Set by cparam_compile_adaptive().
+    struct cparam_key_order * key_order;
+
+    // Message ids of name and desc in a message catalog, 0 if none.
+    unsigned int name_msg;
+    unsigned int desc_msg;
 };
 
 
@@ -68,33 +91,89 @@ struct cparam_keyword_info {
 };
 
 #define CPARAM_INFO_STRING(name, desc, next) \
-    {CPARAM_STRING, false, 0, 0, NULL, 0, next, NULL, NULL, name, desc, NULL, 0, 0}
+    {CPARAM_STRING, false, 0, 0, NULL, 0, 0, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_LAST_STRING(name, desc, action, data) \
-    {CPARAM_STRING, false, 0, 0, NULL, 0, NULL, action, data, name, desc, NULL, 0, 0}
+    {CPARAM_STRING, false, 0, 0, NULL, 0, 0, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_INT(name, desc, next) \
-    {CPARAM_INT, false, 0, 0, NULL, 0, next, NULL, NULL, name, desc, NULL, 0, 0}
+    {CPARAM_INT, false, 0, 0, NULL, 0, 0, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_LAST_INT(name, desc, action, data) \
-    {CPARAM_INT, false, 0, 0, NULL, 0, NULL, action, data, name, desc, NULL, 0, 0}
+    {CPARAM_INT, false, 0, 0, NULL, 0, 0, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_INT_RANGE(name, desc, min, max, next) \
-    {CPARAM_INT, true, min, max, NULL, 0, next, NULL, NULL, name, desc, NULL, 0, 0}
+    {CPARAM_INT, true, min, max, NULL, 0, 0, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_LAST_INT_RANGE(name, desc, min, max, action, data) \
-    {CPARAM_INT, true, min, max, NULL, 0, NULL, action, data, name, desc, NULL, 0, 0}
+    {CPARAM_INT, true, min, max, NULL, 0, 0, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_KEYWORD(name, desc, key_list, next) \
-    {CPARAM_KEYWORD, false, 0, 0, key_list, DIM(key_list), next, NULL, NULL, name, desc, NULL, 0, 0}
+    {CPARAM_KEYWORD, false, 0, 0, key_list, DIM(key_list), 0, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_LAST_KEYWORD(name, desc, key_list, action, data) \
-    {CPARAM_KEYWORD, false, 0, 0, key_list, DIM(key_list), NULL, action, data, name, desc, NULL, 0, 0}
+    {CPARAM_KEYWORD, false, 0, 0, key_list, DIM(key_list), 0, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+/* For keyword lists that aren't arrays, such as ones built at run time. */
+#define CPARAM_INFO_KEYWORD_N(name, desc, key_list, key_lim, next) \
+    {CPARAM_KEYWORD, false, 0, 0, key_list, key_lim, 0, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+#define CPARAM_INFO_LAST_KEYWORD_N(name, desc, key_list, key_lim, action, data) \
+    {CPARAM_KEYWORD, false, 0, 0, key_list, key_lim, 0, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+/*
+    Any of the keys in key_list, in any order, as "key=value" or "key value".
+    The value is parsed by the key's next_param, or if that's NULL the key is a
+    flag with no value. Up to 64 keys.
+ */
+#define CPARAM_KEY_BIT(key_idx) ((uint64_t)1 << (key_idx))
+
+#define CPARAM_INFO_KEYVAL(name, desc, key_list, required, next) \
+    {CPARAM_KEYVAL, false, 0, 0, key_list, DIM(key_list), required, NULL, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+#define CPARAM_INFO_LAST_KEYVAL(name, desc, key_list, required, action, data) \
+    {CPARAM_KEYVAL, false, 0, 0, key_list, DIM(key_list), required, NULL, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+/*
+    A string that has to match a regular expression: literal characters, ".",
+    [...] and [^...] classes, \d \w \s, (...) groups, "|", and "*", "+",
+    "?", {n}, {n,} and {n,m} repeats. The whole argument has to match.
+ */
+#define CPARAM_INFO_PATTERN(name, desc, pattern, next) \
+    {CPARAM_PATTERN, false, 0, 0, NULL, 0, 0, pattern, next, NULL, NULL, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
+
+#define CPARAM_INFO_LAST_PATTERN(name, desc, pattern, action, data) \
+    {CPARAM_PATTERN, false, 0, 0, NULL, 0, 0, pattern, NULL, action, data, name, desc, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 #define CPARAM_INFO_ACTION(action, data) \
-    {CPARAM_ACTION, false, 0, 0, NULL, 0, NULL, action, data, NULL, NULL, NULL, 0, 0}
+    {CPARAM_ACTION, false, 0, 0, NULL, 0, 0, NULL, NULL, action, data, NULL, NULL, NULL, 0, 0, 0, NULL, NULL, 0, 0}
 
 struct cparam_info * cparam_next(struct cparam_info * const param);
+bool cparam_compile(
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    size_t err_msg_size
+);
+/*
+    Same as cparam_compile(), and keyword lists are also given a scan order
+    that follows which keywords are matched most.
+ */
+bool cparam_compile_adaptive(
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    size_t err_msg_size
+);
+void cparam_compile_free(struct cparam_info * const start_param);
+/*
+    Most steps cparam_process() can take for start_param when no argument is
+    longer than arg_len_max, not counting actions. A step is looking at one
+    byte of an argument or keyword, going to the next parameter, or halving
+    one keyword's count in a cparam_compile_adaptive() scan order.
+ */
+size_t cparam_steps_max(
+    const struct cparam_info * const start_param,
+    const size_t arg_len_max
+);
 bool cparam_process(
     const int argc,
     const char * const argv[],
@@ -103,6 +182,306 @@ bool cparam_process(
     char * const err_msg,
     size_t err_msg_size
 );
+/*
+    Arguments scanned once, for when the same argv is processed by many calls.
+    Parsing with the scanned arguments doesn't go over each string again to
+    find its length, look for "=", or convert it to an integer.
+ */
+#define CPARAM_ARG_NUMERIC 0x01    // Starts with an integer, in int_val.
+#define CPARAM_ARG_OPTION 0x02     // Starts with "-", but isn't a number.
+#define CPARAM_ARG_HAS_EQUALS 0x04 // Has "=", at key_len.
+
+struct cparam_arg {
+    size_t len;
+    size_t key_len;    // Up to the first "=", or len if there isn't one.
+    uint64_t hash;     // FNV-1a, including the NUL.
+    long int_val;      // If CPARAM_ARG_NUMERIC, as strtol() gives it.
+    unsigned int flags;
+};
+
+struct cparam_argv {
+    const int argc;
+    const char * const * const argv;
+    struct cparam_arg * const args; // argc of them.
+};
+
+#define CPARAM_ARGV_INIT(argc, argv, args) \
+    {argc, argv, args}
+
+void cparam_argv_scan(struct cparam_argv * const argv_desc);
+bool cparam_process_argv(
+    const struct cparam_argv * const argv_desc,
+    int * argv_idx,  // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    size_t err_msg_size
+);
+
+/*
+    Canonical form of parsed parameters: keywords are their full names, integers
+    are decimal, strings are quoted if they need to be. Returns the length it
+    needs, like snprintf().
+ */
+size_t cparam_canonical(
+    const struct cparam_info * const start_param,
+    char * const buf,
+    size_t buf_size
+);
+
+/*
+    Cache of parse results, for when the same arguments are processed over and
+    over. Parses that use more than CPARAM_CACHE_NODE_MAX parameters, or
+    arguments longer than CPARAM_CACHE_ARGS_SIZE in total, are not cached.
+ */
+#ifndef CPARAM_CACHE_NODE_MAX
+#define CPARAM_CACHE_NODE_MAX 16
+#endif
+#ifndef CPARAM_CACHE_ARGS_SIZE
+#define CPARAM_CACHE_ARGS_SIZE 128
+#endif
+
+struct cparam_cache_node {
+    struct cparam_info * param;
+    int argv_offset; // From first argument, -1 if no argument.
+    int arg_cnt;     // Number of arguments used.
+    int str_offset;  // Where str_val starts in the argument.
+    bool is_key_value; // Value of a CPARAM_KEYVAL key.
+    int int_val;
+    int key_idx;
+    uint64_t key_seen;
+};
+
+/*
+    What a parse looked at after the arguments it used. A CPARAM_KEYVAL list
+    that ends the parse reads the next argument to know it isn't a key.
+ */
+enum cparam_cache_peek {
+    CPARAM_CACHE_PEEK_NONE,
+    CPARAM_CACHE_PEEK_ARG, // The next argument, stored after the ones used.
+    CPARAM_CACHE_PEEK_END, // That there were no more arguments.
+};
+
+struct cparam_cache_entry {
+    uint64_t hash;
+    const struct cparam_info * start_param; // NULL if entry is empty.
+    unsigned long generation; // Of the cache's grammar when it was made.
+    unsigned int node_lim;
+    unsigned int arg_lim;
+    enum cparam_cache_peek peek;
+    struct cparam_cache_node nodes[CPARAM_CACHE_NODE_MAX];
+    char args[CPARAM_CACHE_ARGS_SIZE]; // Each argument NUL terminated.
+};
+
+struct cparam_cache {
+    struct cparam_cache_entry * const entries;
+    const unsigned int entry_lim;
+    // Grammar start_param comes from, see cparam_rcu.h. NULL if none.
+    const struct cparam_grammar * const grammar;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+/* Entries must be zeroed, so a static array, or cparam_cache_clear(). */
+#define CPARAM_CACHE_INIT(entries) \
+    {entries, DIM(entries), NULL, 0, 0}
+#define CPARAM_CACHE_INIT_GRAMMAR(entries, grammar) \
+    {entries, DIM(entries), grammar, 0, 0}
+
+void cparam_cache_clear(struct cparam_cache * const cache);
+bool cparam_process_cached(
+    struct cparam_cache * const cache,
+    const int argc,
+    const char * const argv[],
+    int * argv_idx,  // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    size_t err_msg_size
+);
+bool cparam_process_cached_argv(
+    struct cparam_cache * const cache,
+    const struct cparam_argv * const argv_desc,
+    int * argv_idx,  // argv position to start, updated to last one parsed.
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    size_t err_msg_size
+);
+
+/*
+    Binary record of parsed parameters, for passing to another process. It can
+    be read where it is (shared memory, a socket buffer) without decoding.
+    Numbers are in host byte order.
+ */
+#define CPARAM_RECORD_MAGIC 0x32525043 // "CPR2" little endian.
+#define CPARAM_RECORD_ALIGN 4
+#define CPARAM_RECORD_HAS_STR 0x01
+#define CPARAM_RECORD_KEY_VALUE 0x02 // Key of the CPARAM_KEYVAL before it.
+#define CPARAM_RECORD_VALUE 0x04 // Value of the key node before it.
+
+struct cparam_record_header {
+    uint32_t magic;
+    uint32_t size;       // Whole record, including padding at the end.
+    uint16_t node_lim;
+    uint16_t reserved;
+    uint32_t str_offset; // From start of record.
+};
+
+/* Follows header, one for each parameter parsed, in order. */
+struct cparam_record_node {
+    uint16_t node_id;    // Position in parse, start_param is 0.
+    uint8_t type;        // enum cparam_type.
+    uint8_t flags;
+    int32_t key_idx;     // For CPARAM_KEYWORD and CPARAM_RECORD_KEY_VALUE.
+    int32_t int_val;     // For CPARAM_INT and CPARAM_KEYWORD.
+    uint32_t str_offset; // From start of record, NUL terminated.
+    uint32_t str_len;    // Not including the NUL.
+};
+
+size_t cparam_record_write(
+    const struct cparam_info * const start_param,
+    void * const buf,
+    const size_t buf_size
+);
+bool cparam_record_check(const void * const buf, const size_t buf_size);
+const struct cparam_record_node * cparam_record_nodes(
+    const void * const record
+);
+const char * cparam_record_str(
+    const void * const record,
+    const struct cparam_record_node * const node
+);
+
+/*
+    Config file, where each line is an option name followed by the arguments
+    for its cparam_info. The file is mapped into memory and split up in place,
+    so parsed str_val pointers point into it until it's closed.
+ */
+#ifndef CPARAM_CONFIG_ARG_MAX
+#define CPARAM_CONFIG_ARG_MAX 64
+#endif
+
+struct cparam_config {
+    char * map;
+    size_t map_size;
+    size_t file_size;
+};
+
+struct cparam_config_option {
+    const char * const name;
+    struct cparam_info * const param;
+};
+
+bool cparam_config_open(
+    struct cparam_config * const config,
+    const char * const file_name,
+    char * const err_msg,
+    size_t err_msg_size
+);
+bool cparam_config_process(
+    struct cparam_config * const config,
+    const struct cparam_config_option * const options,
+    const unsigned int option_lim,
+    int * const line_num, // Set to line of error. May be NULL.
+    char * const err_msg,
+    size_t err_msg_size
+);
+void cparam_config_close(struct cparam_config * const config);
+
+/*
+    Messages, for errors and usage. Ids don't change between versions, since
+    message catalogs are compiled with them. A program's own messages start at
+    CPARAM_MSG_USER.
+ */
+enum cparam_msg_id {
+    CPARAM_MSG_MISSING_ARGUMENTS = 1,
+    CPARAM_MSG_NOT_INTEGER = 2,
+    CPARAM_MSG_OUT_OF_RANGE = 3,
+    CPARAM_MSG_KEYWORD_UNKNOWN = 4,
+    CPARAM_MSG_KEYWORD_AMBIGUOUS = 5,
+    CPARAM_MSG_SUGGEST_FIRST = 6,
+    CPARAM_MSG_SUGGEST_NEXT = 7,
+    CPARAM_MSG_SUGGEST_END = 8,
+    CPARAM_MSG_KEY_UNKNOWN = 9,
+    CPARAM_MSG_KEY_AMBIGUOUS = 10,
+    CPARAM_MSG_KEY_PAST_MAX = 11,
+    CPARAM_MSG_KEY_REPEATED = 12,
+    CPARAM_MSG_KEY_NO_VALUE = 13,
+    CPARAM_MSG_KEY_MISSING_VALUE = 14,
+    CPARAM_MSG_KEY_BAD_VALUE_TYPE = 15,
+    CPARAM_MSG_KEY_MISSING = 16,
+    CPARAM_MSG_NULL_PARAMETER = 17,
+    CPARAM_MSG_COMPILE_NO_MEMORY = 18,
+    CPARAM_MSG_FILE_OPEN = 19,
+    CPARAM_MSG_FILE_READ = 20,
+    CPARAM_MSG_FILE_MAP = 21,
+    CPARAM_MSG_CONFIG_TOO_MANY = 22,
+    CPARAM_MSG_CONFIG_NO_QUOTE = 23,
+    CPARAM_MSG_CONFIG_NO_SPACE = 24,
+    CPARAM_MSG_CONFIG_UNKNOWN = 25,
+    CPARAM_MSG_CONFIG_UNUSED = 26,
+    CPARAM_MSG_CATALOG_BAD = 27,
+    CPARAM_MSG_USAGE_STRING = 28,
+    CPARAM_MSG_USAGE_INTEGER = 29,
+    CPARAM_MSG_USAGE_KEYWORD = 30,
+    CPARAM_MSG_USAGE_KEYVAL = 31,
+    CPARAM_MSG_USAGE_ONE_OF = 32,
+    CPARAM_MSG_USAGE_ANY_OF = 33,
+    CPARAM_MSG_USAGE_REQUIRED = 34,
+    CPARAM_MSG_CAPTURE_BAD = 35,
+    CPARAM_MSG_PATTERN_MISMATCH = 36,
+    CPARAM_MSG_PATTERN_BAD = 37,
+    CPARAM_MSG_PATTERN_COMPLEX = 38,
+    CPARAM_MSG_PATTERN_NO_MEMORY = 39,
+    CPARAM_MSG_USAGE_PATTERN = 40,
+    CPARAM_MSG_USAGE_MATCHING = 41,
+    CPARAM_MSG_ACTION_FAILED = 42,
+    CPARAM_MSG_PATTERN_NOT_COMPILED = 43,
+    CPARAM_MSG_PATTERN_NULL = 44,
+    CPARAM_MSG_LIM,
+
+    CPARAM_MSG_USER = 1024,
+};
+
+/*
+    Compiled message catalog, mapped into memory. Built from text by
+    cparam_catalog_write() (see cparam_msgc).
+ */
+#define CPARAM_CATALOG_MAGIC 0x314d5043 // "CPM1" little endian.
+
+struct cparam_catalog_header {
+    uint32_t magic;
+    uint32_t size;    // Whole catalog.
+    uint32_t msg_lim; // Followed by msg_lim uint32_t string offsets.
+    uint32_t reserved;
+};
+
+struct cparam_catalog {
+    const char * map;
+    size_t map_size;
+};
+
+size_t cparam_catalog_write(
+    const char * const msgs[], // msg_lim of them, NULL if not in catalog.
+    const unsigned int msg_lim,
+    void * const buf,
+    const size_t buf_size
+);
+bool cparam_catalog_open(
+    struct cparam_catalog * const catalog,
+    const char * const file_name,
+    char * const err_msg,
+    size_t err_msg_size
+);
+void cparam_catalog_close(struct cparam_catalog * const catalog);
+/* Catalog for cparam_msg() to use, NULL for the built in messages. */
+void cparam_catalog_use(const struct cparam_catalog * const catalog);
+const char * cparam_msg(const unsigned int msg_id);
+/*
+    Message id of why the last parse on this thread failed. Built with
+    CPARAM_REALTIME, this is the only error information, err_msg is left
+    empty.
+ */
+unsigned int cparam_error(void);
+
 void cparam_print_param_names(const struct cparam_info * const start_param);
 void cparam_print(const struct cparam_info * const start_param);
 #endif  // CPARAM_H
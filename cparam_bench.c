@@ -0,0 +1,218 @@
+/*
+    Keyword matching times for skewed command traffic, comparing keyword
+    lists scanned in list order (cparam_compile()) with lists scanned in the
+    order cparam_compile_adaptive() keeps.
+
+    Keywords are drawn from a Zipf distribution, so with skew 0 every keyword
+    is as likely as any other, and the higher the skew, the more the few most
+    likely keywords make up most of the traffic. The most likely keywords are
+    placed at random in the list, so list order doesn't happen to suit them.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cparam.h"
+
+#define KEY_MAX 256
+#define LOOKUP_LIM (1 << 20)
+#define ROUND_LIM 5
+
+static char key_names[KEY_MAX][16];
+static struct cparam_keyword_info * key_list;
+static const char * lookups[LOOKUP_LIM];
+
+static uint64_t rand_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rand_next(void) {
+    // xorshift64*
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * UINT64_C(0x2545f4914f6cdd1d);
+}
+
+static double rand_unit(void) {
+    return (rand_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+    Distinct made up words, from 2 to 4 syllables. The list is built in heap
+    memory, since keyword info members are const.
+ */
+static void make_keys(const unsigned int key_lim) {
+    key_list = malloc(key_lim * sizeof(*key_list));
+    if (NULL == key_list) {
+        printf("Out of memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    static const char consonants[] = "bdfgklmnprstvz";
+    static const char vowels[] = "aeiou";
+    for (unsigned int key_idx = 0;key_idx < key_lim;key_idx++) {
+        bool is_new = false;
+        while (!is_new) {
+            const unsigned int syllable_lim = 2 + rand_next() % 3;
+            char * name = key_names[key_idx];
+            for (unsigned int syllable_idx = 0;
+                syllable_idx < syllable_lim;
+                syllable_idx++)
+            {
+                *name++ = consonants[rand_next() % (sizeof(consonants) - 1)];
+                *name++ = vowels[rand_next() % (sizeof(vowels) - 1)];
+            }
+            *name = '\0';
+            is_new = true;
+            for (unsigned int prev_idx = 0;prev_idx < key_idx;prev_idx++) {
+                if (0 == strcmp(key_names[prev_idx], key_names[key_idx])) {
+                    is_new = false;
+                }
+            }
+        }
+        const struct cparam_keyword_info key =
+            {key_names[key_idx], key_idx, NULL};
+        memcpy(&key_list[key_idx], &key, sizeof(key));
+    }
+}
+
+/*
+    Fill lookups with keywords drawn with probability proportional to
+    1 / rank^skew. Ranks are given to keywords in a random order. Every
+    prefix_per_1000 lookups in 1000 is a unique prefix instead of the whole
+    keyword, which always has to try every keyword.
+ */
+static void make_lookups(
+    const unsigned int key_lim,
+    const double skew,
+    const unsigned int prefix_per_1000
+) {
+    unsigned int rank_key[KEY_MAX];
+    for (unsigned int rank = 0;rank < key_lim;rank++) {
+        rank_key[rank] = rank;
+    }
+    for (unsigned int rank = key_lim - 1;rank > 0;rank--) {
+        const unsigned int swap_rank = rand_next() % (rank + 1);
+        const unsigned int swap_key = rank_key[rank];
+        rank_key[rank] = rank_key[swap_rank];
+        rank_key[swap_rank] = swap_key;
+    }
+    double cumulative[KEY_MAX];
+    double total = 0;
+    for (unsigned int rank = 0;rank < key_lim;rank++) {
+        total += 1.0 / pow(rank + 1, skew);
+        cumulative[rank] = total;
+    }
+    // Shortest unique prefix of each keyword, if it has one.
+    static char prefixes[KEY_MAX][16];
+    for (unsigned int key_idx = 0;key_idx < key_lim;key_idx++) {
+        const char * const name = key_names[key_idx];
+        const size_t name_len = strlen(name);
+        strcpy(prefixes[key_idx], name);
+        for (size_t prefix_len = 1;prefix_len < name_len;prefix_len++) {
+            unsigned int match_cnt = 0;
+            for (unsigned int other_idx = 0;other_idx < key_lim;other_idx++) {
+                if (0 == strncmp(key_names[other_idx], name, prefix_len)) {
+                    match_cnt++;
+                }
+            }
+            if (1 == match_cnt) {
+                prefixes[key_idx][prefix_len] = '\0';
+                break;
+            }
+        }
+    }
+    for (unsigned int lookup_idx = 0;lookup_idx < LOOKUP_LIM;lookup_idx++) {
+        const double target = rand_unit() * total;
+        unsigned int rank = 0;
+        while ((rank < key_lim - 1) && (cumulative[rank] < target)) {
+            rank++;
+        }
+        const unsigned int key_idx = rank_key[rank];
+        lookups[lookup_idx] = (rand_next() % 1000 < prefix_per_1000)
+            ? prefixes[key_idx]
+            : key_names[key_idx];
+    }
+}
+
+/* Best of ROUND_LIM runs over all lookups, in ns per lookup. */
+static double time_lookups(struct cparam_info * const param) {
+    double best_ns = 0;
+    for (unsigned int round_idx = 0;round_idx < ROUND_LIM;round_idx++) {
+        unsigned long check = 0;
+        const uint64_t start_ns = now_ns();
+        for (unsigned int lookup_idx = 0;
+            lookup_idx < LOOKUP_LIM;
+            lookup_idx++)
+        {
+            int argv_idx = 0;
+            if (!cparam_process(1, &lookups[lookup_idx], &argv_idx,
+                param, NULL, 0)
+            ) {
+                printf("No match for \"%s\".\n", lookups[lookup_idx]);
+                exit(EXIT_FAILURE);
+            }
+            check += param->key_idx;
+        }
+        const double round_ns = (double)(now_ns() - start_ns) / LOOKUP_LIM;
+        if ((0 == round_idx) || (round_ns < best_ns)) {
+            best_ns = round_ns;
+        }
+        if (0 == check) {
+            // Keep the loop from being optimized away.
+            printf(" ");
+        }
+    }
+    return best_ns;
+}
+
+static void bench(
+    const unsigned int key_lim,
+    const double skew,
+    const unsigned int prefix_per_1000
+) {
+    make_lookups(key_lim, skew, prefix_per_1000);
+
+    struct cparam_info list_param =
+        CPARAM_INFO_KEYWORD_N("bench", "", key_list, key_lim, NULL);
+    struct cparam_info adaptive_param =
+        CPARAM_INFO_KEYWORD_N("bench", "", key_list, key_lim, NULL);
+    char err_msg[256];
+    if ( !cparam_compile(&list_param, err_msg, sizeof(err_msg))
+      || !cparam_compile_adaptive(&adaptive_param, err_msg, sizeof(err_msg))
+    ) {
+        printf("%s\n", err_msg);
+        exit(EXIT_FAILURE);
+    }
+    const double list_ns = time_lookups(&list_param);
+    const double adaptive_ns = time_lookups(&adaptive_param);
+    printf("%4u %5.1f %7.1f%% %9.1f %9.1f %7.2fx\n",
+        key_lim, skew, prefix_per_1000 / 10.0,
+        list_ns, adaptive_ns, list_ns / adaptive_ns
+    );
+    cparam_compile_free(&list_param);
+    cparam_compile_free(&adaptive_param);
+}
+
+int main(void) {
+    static const unsigned int key_lims[] = {32, 64, 256};
+    static const double skews[] = {0.0, 0.8, 1.2, 2.0};
+    make_keys(KEY_MAX);
+
+    printf("keys  skew prefixes   list ns  adapt ns speedup\n");
+    for (unsigned int lim_idx = 0;lim_idx < DIM(key_lims);lim_idx++) {
+        for (unsigned int skew_idx = 0;skew_idx < DIM(skews);skew_idx++) {
+            bench(key_lims[lim_idx], skews[skew_idx], 0);
+        }
+        bench(key_lims[lim_idx], 1.2, 100);
+    }
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,438 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cparam.h"
+#include "cparam_capture.h"
+#include "cparam_internal.h"
+
+_Atomic(struct cparam_capture *) cparam_capture_current = NULL;
+atomic_uint cparam_capture_users = 0;
+
+bool
+cparam_capture_open(
+    struct cparam_capture * const capture,
+    const char * const file_name,
+    const struct cparam_config_option * const options,
+    const unsigned int option_lim,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    capture->fd = -1;
+    capture->options = options;
+    capture->option_lim = option_lim;
+    atomic_init(&capture->dropped, 0);
+
+    /* Appended, so records written by different threads don't overlap. */
+    const int fd = open(file_name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (-1 == fd)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_OPEN), file_name, strerror(errno)
+            );
+        }
+        return false;
+    }
+    struct stat file_stat;
+    if (-1 == fstat(fd, &file_stat))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_READ), file_name, strerror(errno)
+            );
+        }
+        close(fd);
+        return false;
+    }
+    if (0 == file_stat.st_size)
+    {
+        const struct cparam_capture_header header = {CPARAM_CAPTURE_MAGIC, 0};
+        if (sizeof(header) != write(fd, &header, sizeof(header)))
+        {
+            if (NULL != err_msg)
+            {
+                snprintf(err_msg, err_msg_size,
+                    cparam_msg(CPARAM_MSG_FILE_OPEN),
+                    file_name, strerror(errno)
+                );
+            }
+            close(fd);
+            return false;
+        }
+    }
+    capture->fd = fd;
+    return true;
+}
+
+void
+cparam_capture_use(struct cparam_capture * const capture)
+{
+    atomic_store(&cparam_capture_current, capture);
+}
+
+void
+cparam_capture_close(struct cparam_capture * const capture)
+{
+    struct cparam_capture * current = capture;
+    atomic_compare_exchange_strong(&cparam_capture_current, &current, NULL);
+    /* A parse that got this capture before it was stopped (here, or by using
+       another one) may still be writing to it. */
+    while (0 != atomic_load(&cparam_capture_users))
+    {
+        sched_yield();
+    }
+    if (-1 != capture->fd)
+    {
+        close(capture->fd);
+    }
+    capture->fd = -1;
+}
+
+void
+cparam_capture_add(
+    struct cparam_capture * const capture,
+    const int argc,
+    const char * const argv[],
+    const int argv_start,
+    const int * const argv_idx,
+    const bool ok,
+    const struct cparam_info * const start_param
+) {
+    if ((NULL == argv) || (NULL == start_param))
+    {
+        return;
+    }
+    const char * name = NULL;
+    for (unsigned int option_idx = 0;
+        option_idx < capture->option_lim;
+        option_idx++)
+    {
+        if (capture->options[option_idx].param == start_param)
+        {
+            name = capture->options[option_idx].name;
+            break;
+        }
+    }
+    if (NULL == name)
+    {
+        return;
+    }
+
+    /* Build the whole record first, so it's written in one go. */
+    uint64_t buf[CPARAM_CAPTURE_RECORD_MAX / sizeof(uint64_t)];
+    struct cparam_capture_record * const record =
+        (struct cparam_capture_record *)buf;
+    char * const str_start = (char *)(record + 1);
+    const size_t str_size = sizeof(buf) - sizeof(*record);
+    size_t str_len = 0;
+    const int arg_lim = (argc > argv_start) ? argc - argv_start : 0;
+    for (int arg_idx = -1;arg_idx < arg_lim;arg_idx++)
+    {
+        // Option name first.
+        const char * const str =
+            (arg_idx < 0) ? name : argv[argv_start + arg_idx];
+        const size_t len = strlen(str) + 1;
+        if ((len > str_size - str_len) || (arg_lim > UINT16_MAX))
+        {
+            atomic_fetch_add(&capture->dropped, 1);
+            return;
+        }
+        memcpy(str_start + str_len, str, len);
+        str_len += len;
+    }
+    const size_t size =
+        (sizeof(*record) + str_len + CPARAM_CAPTURE_ALIGN - 1)
+            & ~(size_t)(CPARAM_CAPTURE_ALIGN - 1);
+    memset(str_start + str_len, 0, size - sizeof(*record) - str_len);
+
+    record->size = size;
+    record->arg_lim = arg_lim;
+    record->ok = ok;
+    record->flags = 0;
+    record->arg_end = 0;
+    if (NULL != argv_idx)
+    {
+        record->flags |= CPARAM_CAPTURE_HAS_END;
+        record->arg_end = *argv_idx - argv_start;
+    }
+    record->reserved2 = 0;
+    record->result_hash = ok ? cparam_result_hash(start_param) : 0;
+    if ((ssize_t)size != write(capture->fd, buf, size))
+    {
+        atomic_fetch_add(&capture->dropped, 1);
+    }
+}
+
+/*
+    Check a record is inside the capture and its strings are all NUL terminated
+    inside it. Returns the number of strings, option name included, or 0.
+ */
+static unsigned int
+cparam_replay_check(
+    const char * const map,
+    const size_t map_size,
+    const size_t offset
+) {
+    const struct cparam_capture_record * const record =
+        (const struct cparam_capture_record *)(map + offset);
+    if ( (map_size - offset < sizeof(*record))
+      || (record->size < sizeof(*record))
+      || (record->size > map_size - offset)
+      || (0 != (record->size & (CPARAM_CAPTURE_ALIGN - 1))) )
+    {
+        return 0;
+    }
+    const char * str = (const char *)(record + 1);
+    const char * const record_end = map + offset + record->size;
+    for (unsigned int str_idx = 0;str_idx <= record->arg_lim;str_idx++)
+    {
+        const char * const str_end = memchr(str, '\0', record_end - str);
+        if (NULL == str_end)
+        {
+            return 0;
+        }
+        str = str_end + 1;
+    }
+    return record->arg_lim + 1;
+}
+
+static uint64_t
+cparam_replay_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int
+cparam_replay_compare(const void * const a, const void * const b)
+{
+    const uint64_t a_ns = *(const uint64_t *)a;
+    const uint64_t b_ns = *(const uint64_t *)b;
+    return (a_ns > b_ns) - (a_ns < b_ns);
+}
+
+/* Nearest rank, of sorted latencies. */
+static uint64_t
+cparam_replay_percentile(
+    const uint64_t * const latency_ns,
+    const unsigned long latency_lim,
+    const unsigned int per_mille
+) {
+    if (0 == latency_lim)
+    {
+        return 0;
+    }
+    const unsigned long rank = (latency_lim * per_mille + 999) / 1000;
+    return latency_ns[(rank > 0) ? rank - 1 : 0];
+}
+
+bool
+cparam_replay_run(
+    struct cparam_replay * const replay,
+    const char * const file_name,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    replay->record_lim = 0;
+    replay->skipped = 0;
+    replay->differences = 0;
+    replay->total_ns = 0;
+    replay->p50_ns = 0;
+    replay->p90_ns = 0;
+    replay->p99_ns = 0;
+    replay->p999_ns = 0;
+    replay->max_ns = 0;
+
+    const int fd = open(file_name, O_RDONLY);
+    if (-1 == fd)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_OPEN), file_name, strerror(errno)
+            );
+        }
+        return false;
+    }
+    struct stat file_stat;
+    if (-1 == fstat(fd, &file_stat))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_READ), file_name, strerror(errno)
+            );
+        }
+        close(fd);
+        return false;
+    }
+    const size_t map_size = file_stat.st_size;
+    const char * map = MAP_FAILED;
+    if (map_size >= sizeof(struct cparam_capture_header))
+    {
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == map)
+        {
+            if (NULL != err_msg)
+            {
+                snprintf(err_msg, err_msg_size,
+                    cparam_msg(CPARAM_MSG_FILE_MAP),
+                    file_name, strerror(errno)
+                );
+            }
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+
+    /* Check it all first, and find how much space the replay needs. */
+    bool is_valid = (MAP_FAILED != map)
+        && ( CPARAM_CAPTURE_MAGIC
+          == ((const struct cparam_capture_header *)map)->magic );
+    unsigned long record_lim = 0;
+    unsigned int str_max = 0;
+    for (size_t offset = sizeof(struct cparam_capture_header);
+        is_valid && (offset < map_size);
+        offset += ((const struct cparam_capture_record *)(map + offset))->size)
+    {
+        const unsigned int str_lim =
+            cparam_replay_check(map, map_size, offset);
+        is_valid = (str_lim > 0);
+        if (str_lim > str_max)
+        {
+            str_max = str_lim;
+        }
+        record_lim++;
+    }
+    uint64_t * latency_ns = NULL;
+    const char ** argv = NULL;
+    if (is_valid)
+    {
+        latency_ns = malloc((record_lim + 1) * sizeof(latency_ns[0]));
+        argv = malloc((str_max + 1) * sizeof(argv[0]));
+    }
+    if (!is_valid || (NULL == latency_ns) || (NULL == argv))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_CAPTURE_BAD), file_name
+            );
+        }
+        free(latency_ns);
+        free(argv);
+        if (MAP_FAILED != map)
+        {
+            munmap((void *)map, map_size);
+        }
+        return false;
+    }
+
+    unsigned long latency_lim = 0;
+    unsigned long record_idx = 0;
+    for (size_t offset = sizeof(struct cparam_capture_header);
+        offset < map_size;
+        offset += ((const struct cparam_capture_record *)(map + offset))->size,
+            record_idx++)
+    {
+        const struct cparam_capture_record * const record =
+            (const struct cparam_capture_record *)(map + offset);
+        const char * const name = (const char *)(record + 1);
+        struct cparam_info * param = NULL;
+        for (unsigned int option_idx = 0;
+            option_idx < replay->option_lim;
+            option_idx++)
+        {
+            if (0 == strcmp(name, replay->options[option_idx].name))
+            {
+                param = replay->options[option_idx].param;
+                break;
+            }
+        }
+        if (NULL == param)
+        {
+            replay->skipped++;
+            continue;
+        }
+        const char * str = name + strlen(name) + 1;
+        for (unsigned int arg_idx = 0;arg_idx < record->arg_lim;arg_idx++)
+        {
+            argv[arg_idx] = str;
+            str += strlen(str) + 1;
+        }
+        argv[record->arg_lim] = NULL;
+
+        char replay_err_msg[256];
+        int argv_idx = 0;
+        const uint64_t start_ns = cparam_replay_now();
+        const bool ok = cparam_process_replay(
+            record->arg_lim, argv, &argv_idx, param,
+            replay_err_msg, sizeof(replay_err_msg),
+            replay
+        );
+        const uint64_t end_ns = cparam_replay_now();
+        latency_ns[latency_lim] = end_ns - start_ns;
+        replay->total_ns += latency_ns[latency_lim];
+        latency_lim++;
+
+        const uint64_t result_hash = ok ? cparam_result_hash(param) : 0;
+        const bool has_end = (0 != (record->flags & CPARAM_CAPTURE_HAS_END));
+        if ( (ok == record->ok)
+          && (!has_end || (argv_idx == record->arg_end))
+          && (result_hash == record->result_hash) )
+        {
+            continue;
+        }
+        replay->differences++;
+        if (NULL != replay->diff_out)
+        {
+            fprintf(replay->diff_out, "%lu: %s", record_idx, name);
+            for (unsigned int arg_idx = 0;arg_idx < record->arg_lim;arg_idx++)
+            {
+                fprintf(replay->diff_out, " %s", argv[arg_idx]);
+            }
+            fprintf(replay->diff_out,
+                "\n    captured: %s, end %d\n    replayed: %s, end %d%s%s\n",
+                record->ok ? "ok" : "failed", (int)record->arg_end,
+                ok ? "ok" : "failed", argv_idx,
+                ok ? "" : ", ",
+                ok ? "" : replay_err_msg
+            );
+            if (ok && record->ok && (result_hash != record->result_hash))
+            {
+                fprintf(replay->diff_out, "    parsed differently\n");
+            }
+        }
+    }
+    replay->record_lim = record_idx;
+
+    qsort(latency_ns, latency_lim, sizeof(latency_ns[0]),
+        cparam_replay_compare
+    );
+    replay->p50_ns = cparam_replay_percentile(latency_ns, latency_lim, 500);
+    replay->p90_ns = cparam_replay_percentile(latency_ns, latency_lim, 900);
+    replay->p99_ns = cparam_replay_percentile(latency_ns, latency_lim, 990);
+    replay->p999_ns = cparam_replay_percentile(latency_ns, latency_lim, 999);
+    replay->max_ns =
+        (latency_lim > 0) ? latency_ns[latency_lim - 1] : 0;
+
+    free(latency_ns);
+    free(argv);
+    munmap((void *)map, map_size);
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef CPARAM_CAPTURE_H
+#define CPARAM_CAPTURE_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cparam.h"
+
+/*
+    Capture of the arguments given to cparam_process() and the other process
+    functions, with what they returned, so they can be replayed later. Only
+    parses of start_params that are in the option list are captured, and the
+    option name is saved with them.
+ */
+#define CPARAM_CAPTURE_MAGIC 0x314c5043 // "CPL1" little endian.
+#define CPARAM_CAPTURE_ALIGN 8
+#define CPARAM_CAPTURE_HAS_END 0x01 // argv_idx wasn't NULL.
+#ifndef CPARAM_CAPTURE_RECORD_MAX
+#define CPARAM_CAPTURE_RECORD_MAX 4096
+#endif
+
+struct cparam_capture_header {
+    uint32_t magic;
+    uint32_t reserved;
+};
+
+/* Follows header, one for each parse. */
+struct cparam_capture_record {
+    uint32_t size;       // Whole record, including padding at the end.
+    uint16_t arg_lim;    // Arguments after the option name.
+    uint8_t ok;          // What the process function returned.
+    uint8_t flags;
+    int32_t arg_end;     // argv_idx it returned, from the first argument.
+    uint32_t reserved2;
+    uint64_t result_hash; // Hash of cparam_canonical() if ok, 0 otherwise.
+    // Then the option name and arguments, each NUL terminated.
+};
+
+struct cparam_capture {
+    int fd;
+    const struct cparam_config_option * options;
+    unsigned int option_lim;
+    atomic_ulong dropped; // Too big, or couldn't be written.
+};
+
+bool cparam_capture_open(
+    struct cparam_capture * const capture,
+    const char * const file_name,
+    const struct cparam_config_option * const options,
+    const unsigned int option_lim,
+    char * const err_msg,
+    size_t err_msg_size
+);
+/* Capture to use from now on, NULL to stop. */
+void cparam_capture_use(struct cparam_capture * const capture);
+/*
+    Stop the capture if it's in use, and wait for parses still adding to any
+    capture, then close the file.
+ */
+void cparam_capture_close(struct cparam_capture * const capture);
+
+/*
+    Replay a capture against the grammar in options, which can be a different
+    version of the one it was captured from. Differences in what each parse
+    returns are counted, and printed to diff_out if that isn't NULL.
+ */
+struct cparam_replay {
+    const struct cparam_config_option * options;
+    unsigned int option_lim;
+    // If not run_actions, action_stub is called instead, if it isn't NULL.
+    bool run_actions;
+    cparam_action action_stub;
+    void * stub_data;
+    FILE * diff_out; // NULL to only count differences.
+
+    // Results.
+    unsigned long record_lim;
+    unsigned long skipped;     // No option with its name.
+    unsigned long differences;
+    uint64_t total_ns;         // Parsing only.
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+};
+
+bool cparam_replay_run(
+    struct cparam_replay * const replay,
+    const char * const file_name,
+    char * const err_msg,
+    size_t err_msg_size
+);
+
+#endif  // CPARAM_CAPTURE_H
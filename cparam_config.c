@@ -0,0 +1,297 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cparam.h"
+#include "cparam_internal.h"
+
+bool
+cparam_config_open(
+    struct cparam_config * const config,
+    const char * const file_name,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    config->map = NULL;
+    config->map_size = 0;
+    config->file_size = 0;
+
+    const int fd = open(file_name, O_RDONLY);
+    if (-1 == fd)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_OPEN), file_name, strerror(errno)
+            );
+        }
+        return false;
+    }
+    struct stat file_stat;
+    if (-1 == fstat(fd, &file_stat))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_READ), file_name, strerror(errno)
+            );
+        }
+        close(fd);
+        return false;
+    }
+    const size_t file_size = file_stat.st_size;
+
+    /* Reserve space for the file plus a NUL after it, then map the file over
+       the start. The rest stays zeroed, so the last line is always NUL
+       terminated even if the file fills its last page. The mapping is private
+       and writable so lines can be split up in place. */
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t map_size = (file_size / page_size + 1) * page_size;
+    char * const map = mmap(
+        NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0
+    );
+    if ( (MAP_FAILED == map)
+      || ( (file_size > 0)
+        && (MAP_FAILED == mmap(
+                map, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                fd, 0
+            )
+        )
+      )
+    ) {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_MAP), file_name, strerror(errno)
+            );
+        }
+        if (MAP_FAILED != map)
+        {
+            munmap(map, map_size);
+        }
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    config->map = map;
+    config->map_size = map_size;
+    config->file_size = file_size;
+    return true;
+}
+
+void
+cparam_config_close(struct cparam_config * const config)
+{
+    if (NULL != config->map)
+    {
+        munmap(config->map, config->map_size);
+    }
+    config->map = NULL;
+    config->map_size = 0;
+    config->file_size = 0;
+}
+
+/*
+    Split one line into arguments in place, ending each with a NUL. Quoted
+    arguments are unquoted the same way cparam_canonical() quotes them.
+    Returns a pointer to the start of the next line, or NULL on error.
+ */
+static char *
+cparam_config_split(
+    char * line,
+    const char * argv[],
+    int * const argc,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    char * line_ptr = line;
+    *argc = 0;
+    for (;;)
+    {
+        while ((' ' == *line_ptr) || ('\t' == *line_ptr) || ('\r' == *line_ptr))
+        {
+            line_ptr++;
+        }
+        if ('#' == *line_ptr)
+        {
+            // Comment to end of line.
+            line_ptr += strcspn(line_ptr, "\n");
+        }
+        if ('\0' == *line_ptr)
+        {
+            return line_ptr;
+        }
+        if ('\n' == *line_ptr)
+        {
+            return line_ptr + 1;
+        }
+        if (*argc >= CPARAM_CONFIG_ARG_MAX)
+        {
+            if (NULL != err_msg)
+            {
+                snprintf(err_msg, err_msg_size,
+                    cparam_msg(CPARAM_MSG_CONFIG_TOO_MANY),
+                    CPARAM_CONFIG_ARG_MAX
+                );
+            }
+            return NULL;
+        }
+
+        if ('"' == *line_ptr)
+        {
+            line_ptr++;
+            argv[*argc] = line_ptr;
+            // Unescaped argument is never longer, so copy it down over itself.
+            char * arg_end = line_ptr;
+            for (;;)
+            {
+                if ('\\' == *line_ptr)
+                {
+                    line_ptr++;
+                }
+                else if ('"' == *line_ptr)
+                {
+                    break;
+                }
+                if (('\0' == *line_ptr) || ('\n' == *line_ptr))
+                {
+                    if (NULL != err_msg)
+                    {
+                        snprintf(err_msg, err_msg_size,
+                            "%s", cparam_msg(CPARAM_MSG_CONFIG_NO_QUOTE)
+                        );
+                    }
+                    return NULL;
+                }
+                *arg_end = *line_ptr;
+                arg_end++;
+                line_ptr++;
+            }
+            // Skip closing quote.
+            line_ptr++;
+            if ( ('\0' != *line_ptr)
+              && (NULL == strchr(" \t\r\n", *line_ptr)) )
+            {
+                if (NULL != err_msg)
+                {
+                    snprintf(err_msg, err_msg_size,
+                        "%s", cparam_msg(CPARAM_MSG_CONFIG_NO_SPACE)
+                    );
+                }
+                return NULL;
+            }
+            *arg_end = '\0';
+        }
+        else
+        {
+            argv[*argc] = line_ptr;
+            line_ptr += strcspn(line_ptr, " \t\r\n");
+        }
+        (*argc)++;
+
+        /* End the argument, but the end of the line has to be seen. */
+        if ('\n' == *line_ptr)
+        {
+            *line_ptr = '\0';
+            return line_ptr + 1;
+        }
+        if ('\0' != *line_ptr)
+        {
+            *line_ptr = '\0';
+            line_ptr++;
+        }
+    }
+}
+
+bool
+cparam_config_process(
+    struct cparam_config * const config,
+    const struct cparam_config_option * const options,
+    const unsigned int option_lim,
+    int * const line_num,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    if (NULL != line_num)
+    {
+        *line_num = 0;
+    }
+    if (NULL == config->map)
+    {
+        return true;
+    }
+    char * line = config->map;
+    int line_cnt = 0;
+    while ('\0' != *line)
+    {
+        line_cnt++;
+        if (NULL != line_num)
+        {
+            *line_num = line_cnt;
+        }
+        const char * argv[CPARAM_CONFIG_ARG_MAX];
+        int argc = 0;
+        char * const next_line =
+            cparam_config_split(line, argv, &argc, err_msg, err_msg_size);
+        if (NULL == next_line)
+        {
+            return false;
+        }
+        line = next_line;
+        if (0 == argc)
+        {
+            // Blank or comment.
+            continue;
+        }
+
+        /* First argument says which option the line is for. */
+        const struct cparam_config_option * option = NULL;
+        for (unsigned int option_idx = 0;option_idx < option_lim;option_idx++)
+        {
+            if (0 == strcmp(options[option_idx].name, argv[0]))
+            {
+                option = &options[option_idx];
+                break;
+            }
+        }
+        if (NULL == option)
+        {
+            if (NULL != err_msg)
+            {
+                snprintf(err_msg, err_msg_size,
+                    cparam_msg(CPARAM_MSG_CONFIG_UNKNOWN), argv[0]
+                );
+            }
+            return false;
+        }
+        /* argv_idx is left at the start when nothing is used, so count what
+           is used to find leftovers. */
+        int argv_idx = 1;
+        int arg_lim = 0;
+        if ( !cparam_process_used(argc, argv, &argv_idx, option->param,
+                &arg_lim, err_msg, err_msg_size
+            )
+        ) {
+            return false;
+        }
+        if (1 + arg_lim < argc)
+        {
+            if (NULL != err_msg)
+            {
+                snprintf(err_msg, err_msg_size,
+                    cparam_msg(CPARAM_MSG_CONFIG_UNUSED),
+                    argv[1 + arg_lim]
+                );
+            }
+            return false;
+        }
+    }
+    return true;
+}
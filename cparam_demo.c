@@ -3,6 +3,8 @@
 #include <string.h>
 
 #include "cparam.h"
+#include "cparam_capture.h"
+#include "cparam_trace.h"
 
 // Stuff for --tempmon option.
 
@@ -326,6 +328,106 @@ struct cparam_info string_param =
     );
 
 
+// Stuff for --serial option.
+
+enum serial_key {
+    SERIAL_DEVICE,
+    SERIAL_BAUD,
+    SERIAL_PARITY,
+    SERIAL_VERBOSE,
+};
+
+static bool action_serial(
+    struct cparam_info * param,
+    void * data,
+    char * err_msg,
+    size_t err_len
+) {
+    struct cparam_info *scan_param = param;
+    const struct cparam_keyword_info * const key_list = scan_param->key_list;
+
+    printf("Serial action for: %s",
+        key_list[SERIAL_DEVICE].next_param->str_val
+    );
+    if (0 != (scan_param->key_seen & CPARAM_KEY_BIT(SERIAL_BAUD))) {
+        printf(" baud %d", key_list[SERIAL_BAUD].next_param->int_val);
+    }
+    if (0 != (scan_param->key_seen & CPARAM_KEY_BIT(SERIAL_PARITY))) {
+        const struct cparam_info * const parity_param =
+            key_list[SERIAL_PARITY].next_param;
+        printf(" parity %s",
+            parity_param->key_list[parity_param->key_idx].name
+        );
+    }
+    if (0 != (scan_param->key_seen & CPARAM_KEY_BIT(SERIAL_VERBOSE))) {
+        printf(" verbose");
+    }
+    printf(".\n");
+    return true;
+}
+
+struct cparam_info serial_device_param =
+    CPARAM_INFO_PATTERN(
+        "device", "Serial device.", "/dev/tty[A-Z]*[0-9]+", NULL
+    );
+
+struct cparam_info serial_baud_param =
+    CPARAM_INFO_INT_RANGE("baud", "Bits per second.", 50, 921600, NULL);
+
+struct cparam_keyword_info serial_parity_list[] = {
+    {"none", 0, NULL},
+    {"even", 1, NULL},
+    {"odd", 2, NULL},
+};
+
+struct cparam_info serial_parity_param =
+    CPARAM_INFO_KEYWORD("parity", "Parity bit.", serial_parity_list, NULL);
+
+struct cparam_keyword_info serial_list[] = {
+    [SERIAL_DEVICE] = {"device", SERIAL_DEVICE, &serial_device_param},
+    [SERIAL_BAUD] = {"baud", SERIAL_BAUD, &serial_baud_param},
+    [SERIAL_PARITY] = {"parity", SERIAL_PARITY, &serial_parity_param},
+    [SERIAL_VERBOSE] = {"verbose", SERIAL_VERBOSE, NULL},
+};
+
+struct cparam_info serial_param =
+    CPARAM_INFO_LAST_KEYVAL(
+        "settings",
+        "Serial port settings.",
+        serial_list,
+        CPARAM_KEY_BIT(SERIAL_DEVICE),
+        action_serial,
+        NULL
+    );
+
+
+// Options that can be in a config file, without the "--".
+static const struct cparam_config_option config_options[] = {
+    {"tempmon", &tempmon_param},
+    {"int", &int_param},
+    {"intint", &intint_first_param},
+    {"percent", &percent_param},
+    {"string", &string_param},
+    {"serial", &serial_param},
+};
+
+// Kept open, since parsed strings point into them, even once a later file
+// sets the same option.
+#define CONFIG_MAX 8
+static struct cparam_config configs[CONFIG_MAX];
+static unsigned int config_lim = 0;
+
+// Messages of our own in the catalog, after the cparam ones.
+enum demo_msg_id {
+    DEMO_MSG_TEMPMON_DESC = CPARAM_MSG_USER,
+    DEMO_MSG_SERIAL_DESC,
+};
+
+// Kept open while messages are used.
+static struct cparam_catalog catalog;
+
+static struct cparam_capture capture;
+
 static void print_usage(const char * cmd_name) {
     printf("%s <options> [<options> ...]\n", cmd_name);
     printf("Where <options> are:\n");
@@ -359,10 +461,122 @@ static void print_usage(const char * cmd_name) {
     cparam_print(&string_param);
     printf("\n");
 
+    printf("  [-k | --serial] ");
+    cparam_print_param_names(&serial_param);
+    printf("\n");
+    cparam_print(&serial_param);
+
+    printf("  [-c | --config] <file>\n");
+    printf("    <file>: Options, one per line, without the \"--\".\n");
+    printf("    Config files are processed first, in order, so the\n");
+    printf("    command line overrides them.\n");
+    printf("\n");
+
+    printf("  [-R | --replay] <file>\n");
+    printf("    <file>: Capture to parse again, without running actions.\n");
+    printf("\n");
+
     printf("  [-? | --help]: Print this message.\n");
 }
 
+static void process_config(const char * const file_name) {
+    char err_msg[256];
+    int line_num = 0;
+    if (config_lim >= CONFIG_MAX) {
+        printf("More than %d config files.\n", CONFIG_MAX);
+        exit(EXIT_FAILURE);
+    }
+    struct cparam_config * const config = &configs[config_lim];
+    if (!cparam_config_open(config, file_name, err_msg, sizeof(err_msg))) {
+        printf("%s\n", err_msg);
+        exit(EXIT_FAILURE);
+    }
+    config_lim++;
+    if ( !cparam_config_process(
+            config,
+            config_options, DIM(config_options),
+            &line_num,
+            err_msg, sizeof(err_msg)
+        )
+    ) {
+        printf("%s:%d: %s\n", file_name, line_num, err_msg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Options can be repeated, so save parsing them again.
+static struct cparam_cache_entry cache_entries[16];
+static struct cparam_cache cache = CPARAM_CACHE_INIT(cache_entries);
+
 int main(const int argc, const char * const argv[]) {
+    char compile_err_msg[256];
+    // Language is chosen once, before anything is parsed.
+    const char * const catalog_file_name = getenv("CPARAM_DEMO_CATALOG");
+    if (NULL != catalog_file_name) {
+        if ( !cparam_catalog_open(
+                &catalog, catalog_file_name,
+                compile_err_msg, sizeof(compile_err_msg)
+            )
+        ) {
+            printf("%s\n", compile_err_msg);
+            exit(EXIT_FAILURE);
+        }
+        cparam_catalog_use(&catalog);
+        tempmon_param.desc_msg = DEMO_MSG_TEMPMON_DESC;
+        serial_param.desc_msg = DEMO_MSG_SERIAL_DESC;
+    }
+    // Capture every option parsed, to replay later.
+    const char * const capture_file_name = getenv("CPARAM_DEMO_CAPTURE");
+    if (NULL != capture_file_name) {
+        if ( !cparam_capture_open(
+                &capture, capture_file_name,
+                config_options, DIM(config_options),
+                compile_err_msg, sizeof(compile_err_msg)
+            )
+        ) {
+            printf("%s\n", compile_err_msg);
+            exit(EXIT_FAILURE);
+        }
+        cparam_capture_use(&capture);
+    }
+    for (unsigned int option_idx = 0;
+        option_idx < DIM(config_options);
+        option_idx++)
+    {
+        if ( !cparam_compile(
+                config_options[option_idx].param,
+                compile_err_msg, sizeof(compile_err_msg)
+            )
+        ) {
+            printf("%s\n", compile_err_msg);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Every option is parsed from the same argv, so only scan it once.
+    struct cparam_arg * const args = malloc(argc * sizeof(args[0]));
+    if (NULL == args) {
+        printf("Out of memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    struct cparam_argv argv_desc = CPARAM_ARGV_INIT(argc, argv, args);
+    cparam_argv_scan(&argv_desc);
+
+    // Config files first, so the command line overrides them.
+    for (int argi = 1;argi < argc;argi++) {
+        const char * const opt = argv[argi];
+        if ( (0 == strcmp("-c", opt))
+          || (0 == strcmp("--config", opt))
+        ) {
+            argi++;
+            if (argi >= argc) {
+                printf("Missing %s file name.\n", opt);
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            process_config(argv[argi]);
+        }
+    }
+
     for (int argi = 1;argi < argc;argi++) {
         const char * const opt = argv[argi];
         struct cparam_info *param = NULL;
@@ -375,8 +589,10 @@ int main(const int argc, const char * const argv[]) {
             param = &tempmon_param;
             argi++;
             cparam_process_success = 
-                cparam_process(
-                    argc, argv, &argi, &tempmon_param, err_msg, sizeof(err_msg)
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
+                    &tempmon_param,
+                    err_msg, sizeof(err_msg)
                 );
         } else if ( (0 == strcmp("-i", opt))
           || (0 == strcmp("--int", opt))
@@ -384,8 +600,10 @@ int main(const int argc, const char * const argv[]) {
             param = &int_param;
             argi++;
             cparam_process_success = 
-                cparam_process(
-                    argc, argv, &argi, &int_param, err_msg, sizeof(err_msg)
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
+                    &int_param,
+                    err_msg, sizeof(err_msg)
                 );
         } else if ( (0 == strcmp("-I", opt))
           || (0 == strcmp("--intint", opt))
@@ -393,8 +611,8 @@ int main(const int argc, const char * const argv[]) {
             param = &intint_first_param;
             argi++;
             cparam_process_success = 
-                cparam_process(
-                    argc, argv, &argi,
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
                     &intint_first_param,
                     err_msg, sizeof(err_msg)
                 );
@@ -404,8 +622,10 @@ int main(const int argc, const char * const argv[]) {
             param = &percent_param;
             argi++;
             cparam_process_success = 
-                cparam_process(
-                    argc, argv, &argi, &percent_param, err_msg, sizeof(err_msg)
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
+                    &percent_param,
+                    err_msg, sizeof(err_msg)
                 );
         } else if ( (0 == strcmp("-s", opt))
           || (0 == strcmp("--string", opt))
@@ -413,13 +633,74 @@ int main(const int argc, const char * const argv[]) {
             param = &string_param;
             argi++;
             cparam_process_success = 
-                cparam_process(
-                    argc, argv, &argi, &string_param, err_msg, sizeof(err_msg)
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
+                    &string_param,
+                    err_msg, sizeof(err_msg)
+                );
+        } else if ( (0 == strcmp("-k", opt))
+          || (0 == strcmp("--serial", opt))
+        ) {
+            param = &serial_param;
+            argi++;
+            cparam_process_success = 
+                cparam_process_cached_argv(
+                    &cache, &argv_desc, &argi,
+                    &serial_param,
+                    err_msg, sizeof(err_msg)
                 );
+        } else if ( (0 == strcmp("-c", opt))
+          || (0 == strcmp("--config", opt))
+        ) {
+            // Already processed, skip the file name.
+            argi++;
+        } else if ( (0 == strcmp("-R", opt))
+          || (0 == strcmp("--replay", opt))
+        ) {
+            argi++;
+            if (argi >= argc) {
+                printf("Missing %s file name.\n", opt);
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            struct cparam_replay replay = {
+                .options = config_options,
+                .option_lim = DIM(config_options),
+                .run_actions = false,
+                .diff_out = stdout,
+            };
+            if ( !cparam_replay_run(
+                    &replay, argv[argi], err_msg, sizeof(err_msg)
+                )
+            ) {
+                printf("%s\n", err_msg);
+                exit(EXIT_FAILURE);
+            }
+            const double total_s = replay.total_ns / 1e9;
+            const unsigned long parse_cnt =
+                replay.record_lim - replay.skipped;
+            printf("replayed: %lu, skipped: %lu, different: %lu\n",
+                replay.record_lim, replay.skipped, replay.differences
+            );
+            printf("parses/s: %.0f\n",
+                (total_s > 0) ? parse_cnt / total_s : 0
+            );
+            printf(
+                "latency ns: p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu\n",
+                (unsigned long long)replay.p50_ns,
+                (unsigned long long)replay.p90_ns,
+                (unsigned long long)replay.p99_ns,
+                (unsigned long long)replay.p999_ns,
+                (unsigned long long)replay.max_ns
+            );
         } else if ( (0 == strcmp("-?", opt))
           || (0 == strcmp("--help", opt))
         ) {
             print_usage(argv[0]);
+        } else if (0 == (args[argi].flags & CPARAM_ARG_OPTION)) {
+            printf("Unexpected argument: %s\n\n", opt);
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
         } else {
             printf("Unrecognized option: %s\n\n", opt);
             print_usage(argv[0]);
@@ -428,6 +709,33 @@ int main(const int argc, const char * const argv[]) {
 
         if (NULL != param) {
             if (cparam_process_success) {
+                char canonical[256];
+                const size_t canonical_len =
+                    cparam_canonical(param, canonical, sizeof(canonical));
+                if (canonical_len < sizeof(canonical)) {
+                    printf("canonical: %s\n", canonical);
+                } else {
+                    printf("canonical: %zu characters, too long to show\n",
+                        canonical_len
+                    );
+                }
+                // uint32_t for alignment.
+                uint32_t record[64];
+                const size_t record_size =
+                    cparam_record_write(param, record, sizeof(record));
+                if (0 == record_size) {
+                    printf("record: too many parameters to record\n");
+                } else if (record_size > sizeof(record)) {
+                    printf("record: %zu bytes, too big to write\n",
+                        record_size
+                    );
+                } else if (cparam_record_check(record, sizeof(record))) {
+                    const struct cparam_record_header * const header =
+                        (const struct cparam_record_header *)record;
+                    printf("record: %u bytes, %u parameters\n",
+                        header->size, header->node_lim
+                    );
+                }
                 while (NULL != param)
                 {
                     switch (param->type)
@@ -435,6 +743,9 @@ int main(const int argc, const char * const argv[]) {
                     case CPARAM_STRING:
                         printf("string: \"%s\"\n", param->str_val);
                         break;
+                    case CPARAM_PATTERN:
+                        printf("pattern: \"%s\"\n", param->str_val);
+                        break;
                     case CPARAM_INT:
                         printf("int: \"%s\" = %d\n",
                             param->str_val, param->int_val
@@ -450,15 +761,44 @@ int main(const int argc, const char * const argv[]) {
                     case CPARAM_ACTION:
                         printf("action: \n");
                         break;
+                    case CPARAM_KEYVAL:
+                        printf("keyval: \"%s\" = 0x%llx\n",
+                            param->str_val,
+                            (unsigned long long)param->key_seen
+                        );
+                        break;
                     }
                     param = cparam_next(param);
                 }
             } else {
+                if ('\0' == err_msg[0]) {
+                    // Built with CPARAM_REALTIME, there's only the id.
+                    snprintf(err_msg, sizeof(err_msg),
+                        "message %u", cparam_error()
+                    );
+                }
                 printf("Incorrect %s parameters: %s\n", opt, err_msg);
                 print_usage(argv[0]);
                 exit(EXIT_FAILURE);
             }
         }
     }
+    free(args);
+    for (unsigned int config_idx = 0;config_idx < config_lim;config_idx++) {
+        cparam_config_close(&configs[config_idx]);
+    }
+#ifdef CPARAM_TRACE
+    const char * const trace_file_name = getenv("CPARAM_DEMO_TRACE");
+    if (NULL != trace_file_name) {
+        FILE * const trace_file = fopen(trace_file_name, "w");
+        if ( (NULL == trace_file)
+          || !cparam_trace_export(trace_file)
+          || (0 != fclose(trace_file))
+        ) {
+            printf("Could not write trace to %s\n", trace_file_name);
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,117 @@
+#ifndef CPARAM_INTERNAL_H
+#define CPARAM_INTERNAL_H
+/*
+    Shared between the library's source files, not for programs using it.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cparam.h"
+#include "cparam_capture.h"
+
+/*
+    Order to try keywords in, kept by cparam_compile_adaptive(). Each match
+    moves the keyword up one place if it's been matched more than the one
+    before it, and every CPARAM_KEY_ORDER_PERIOD matches the counts are halved
+    so the order follows changes. Like parsed values, it belongs to the
+    cparam_info structs, so it's only used by the thread parsing with them.
+ */
+#define CPARAM_KEY_ORDER_PERIOD 4096
+
+struct cparam_key_order {
+    // Matches since the counts were halved.
+    unsigned int hit_cnt;
+    // Indexed by key_idx.
+    unsigned int * hits;
+    // key_idx to try, in order.
+    unsigned short order[];
+};
+
+int cparam_keyword_match(
+    const struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    int * const key_idx
+);
+
+/*
+    Pattern compiled by cparam_compile(). next[state * class_lim + class] is
+    the state after a byte in that class. State 0 is the state nothing can
+    match from.
+ */
+#define CPARAM_DFA_STATE_MAX 256
+
+struct cparam_dfa {
+    unsigned int state_lim;
+    unsigned int class_lim;
+    unsigned int start;
+    uint8_t byte_class[256];
+    // 1 if the argument matches when it ends in the state.
+    uint8_t accept[CPARAM_DFA_STATE_MAX];
+    uint8_t next[];
+};
+
+bool cparam_pattern_compile(
+    const char * const pattern,
+    struct cparam_dfa ** const dfa,    // Set to malloc()ed DFA.
+    unsigned int * const msg_id,       // Set to why it failed.
+    char * const err_msg,
+    const size_t err_msg_size
+);
+
+bool cparam_pattern_match(
+    const struct cparam_dfa * const dfa,
+    const char * const arg,
+    const size_t arg_len
+);
+
+/*
+    Capture in use, NULL if none. A parsing thread adds to cparam_capture_users
+    before it loads the capture to add a parse to, and takes it off when done,
+    so cparam_capture_close() can wait for it before closing the file. All
+    sequentially consistent, so a thread either loads the capture before close
+    clears it, and is counted, or after, and doesn't get it.
+ */
+extern _Atomic(struct cparam_capture *) cparam_capture_current;
+extern atomic_uint cparam_capture_users;
+
+void cparam_capture_add(
+    struct cparam_capture * const capture,
+    const int argc,
+    const char * const argv[],
+    const int argv_start,
+    const int * const argv_idx, // Where it ended, NULL if not known.
+    const bool ok,
+    const struct cparam_info * const start_param
+);
+
+/* Hash of the canonical form of a successful parse. */
+uint64_t cparam_result_hash(const struct cparam_info * const start_param);
+
+/*
+    cparam_process(), also setting arg_lim to the number of arguments used, for
+    callers that have to know whether any were.
+ */
+bool cparam_process_used(
+    const int argc,
+    const char * const argv[],
+    int * argv_idx,
+    struct cparam_info * const start_param,
+    int * const arg_lim,
+    char * const err_msg,
+    const size_t err_msg_size
+);
+
+/* cparam_process(), with actions run or not as replay says. */
+bool cparam_process_replay(
+    const int argc,
+    const char * const argv[],
+    int * argv_idx,
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size,
+    const struct cparam_replay * const replay
+);
+
+#endif  // CPARAM_INTERNAL_H
@@ -0,0 +1,268 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cparam.h"
+#include "cparam_internal.h"
+
+/*
+    Try keywords in list order. An exact match wins straight away, even if arg
+    is also the start of other keywords.
+ */
+static int
+cparam_keyword_match_list(
+    const struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    int * const key_idx
+) {
+    // Partial matches okay if unique. Count number of matches, if
+    // one then found the keyword.
+    int num_matches = 0;
+    const int key_lim = param->key_lim;
+    for (int current_idx = 0;current_idx < key_lim;current_idx++)
+    {
+        const char * const name = param->key_list[current_idx].name;
+        // Only compare to length of parameter for partial matches.
+        if (0 == strncmp(name, arg, arg_len))
+        {
+            if ('\0' == name[arg_len])
+            {
+                *key_idx = current_idx;
+                return 1;
+            }
+            num_matches++;
+            *key_idx = current_idx;
+        }
+    }
+    return num_matches;
+}
+
+/*
+    Try keywords in the order of cparam_key_order. Since names in the list are
+    all different, an exact match is the only one whatever order keywords are
+    tried in, so the most common can return after a compare or two. Anything
+    else still has to try them all, and gets the same result as in list order.
+ */
+static int
+cparam_keyword_match_order(
+    const struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    int * const key_idx
+) {
+    struct cparam_key_order * const key_order = param->key_order;
+    const unsigned int key_lim = param->key_lim;
+    int num_matches = 0;
+    unsigned int match_order_idx = 0;
+    for (unsigned int order_idx = 0;order_idx < key_lim;order_idx++)
+    {
+        const unsigned short current_idx = key_order->order[order_idx];
+        const char * const name = param->key_list[current_idx].name;
+        if (0 == strncmp(name, arg, arg_len))
+        {
+            match_order_idx = order_idx;
+            if ('\0' == name[arg_len])
+            {
+                num_matches = 1;
+                break;
+            }
+            num_matches++;
+        }
+    }
+    if (1 != num_matches)
+    {
+        return num_matches;
+    }
+    const unsigned short match_idx = key_order->order[match_order_idx];
+    *key_idx = match_idx;
+
+    /* Move it up one place if it's now been matched more than the one before
+       it, so the order is sorted a step at a time, never all at once. */
+    key_order->hits[match_idx]++;
+    if (match_order_idx > 0)
+    {
+        const unsigned short prev_idx = key_order->order[match_order_idx - 1];
+        if (key_order->hits[prev_idx] < key_order->hits[match_idx])
+        {
+            key_order->order[match_order_idx - 1] = match_idx;
+            key_order->order[match_order_idx] = prev_idx;
+        }
+    }
+    if (++key_order->hit_cnt >= CPARAM_KEY_ORDER_PERIOD)
+    {
+        key_order->hit_cnt = 0;
+        for (unsigned int hits_idx = 0;hits_idx < key_lim;hits_idx++)
+        {
+            key_order->hits[hits_idx] /= 2;
+        }
+    }
+    return 1;
+}
+
+/*
+    Find the keyword that arg is the start of. Returns how many keywords match,
+    and if that's 1, sets key_idx to the one that does. A keyword that matches
+    all of arg is the only match, even if arg is the start of others.
+ */
+int
+cparam_keyword_match(
+    const struct cparam_info * const param,
+    const char * const arg,
+    const size_t arg_len,
+    int * const key_idx
+) {
+    if (NULL != param->key_order)
+    {
+        return cparam_keyword_match_order(param, arg, arg_len, key_idx);
+    }
+    return cparam_keyword_match_list(param, arg, arg_len, key_idx);
+}
+
+/*
+    Give a list a scan order, starting in list order. Not for lists with a name
+    more than once, since then which of them matches would depend on the
+    order.
+ */
+static bool
+cparam_compile_order(
+    struct cparam_info * const param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    const unsigned int key_lim = param->key_lim;
+    if ((NULL != param->key_order) || (key_lim < 2) || (key_lim > USHRT_MAX))
+    {
+        return true;
+    }
+    for (unsigned int key_idx = 1;key_idx < key_lim;key_idx++)
+    {
+        for (unsigned int prev_idx = 0;prev_idx < key_idx;prev_idx++)
+        {
+            if ( 0 == strcmp(
+                    param->key_list[key_idx].name,
+                    param->key_list[prev_idx].name
+                )
+            ) {
+                return true;
+            }
+        }
+    }
+    /* Hits go after order, in the same allocation. */
+    const size_t hits_align = _Alignof(unsigned int);
+    const size_t hits_offset = ( sizeof(struct cparam_key_order)
+        + key_lim * sizeof(unsigned short) + hits_align - 1 )
+        / hits_align * hits_align;
+    struct cparam_key_order * const key_order =
+        calloc(1, hits_offset + key_lim * sizeof(unsigned int));
+    if (NULL == key_order)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_COMPILE_NO_MEMORY),
+                (NULL != param->name) ? param->name : ""
+            );
+        }
+        return false;
+    }
+    key_order->hits = (unsigned int *)((char *)key_order + hits_offset);
+    for (unsigned int key_idx = 0;key_idx < key_lim;key_idx++)
+    {
+        key_order->order[key_idx] = (unsigned short)key_idx;
+    }
+    param->key_order = key_order;
+    return true;
+}
+
+static bool
+cparam_compile_main(
+    struct cparam_info * const start_param,
+    const bool adaptive,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    for ( struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        if (CPARAM_PATTERN == param->type)
+        {
+            unsigned int msg_id;
+            if ( (NULL == param->dfa)
+              && !cparam_pattern_compile(param->pattern, &param->dfa,
+                    &msg_id, err_msg, err_msg_size
+                )
+            ) {
+                return false;
+            }
+            continue;
+        }
+        if ((CPARAM_KEYWORD != param->type) && (CPARAM_KEYVAL != param->type))
+        {
+            continue;
+        }
+        if (adaptive && !cparam_compile_order(param, err_msg, err_msg_size))
+        {
+            return false;
+        }
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            if ( !cparam_compile_main(
+                    param->key_list[key_idx].next_param,
+                    adaptive, err_msg, err_msg_size
+                )
+            ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool
+cparam_compile(
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    return cparam_compile_main(start_param, false, err_msg, err_msg_size);
+}
+
+bool
+cparam_compile_adaptive(
+    struct cparam_info * const start_param,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    return cparam_compile_main(start_param, true, err_msg, err_msg_size);
+}
+
+void
+cparam_compile_free(struct cparam_info * const start_param)
+{
+    for ( struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        if (CPARAM_PATTERN == param->type)
+        {
+            free(param->dfa);
+            param->dfa = NULL;
+            continue;
+        }
+        if ((CPARAM_KEYWORD != param->type) && (CPARAM_KEYVAL != param->type))
+        {
+            continue;
+        }
+        free(param->key_order);
+        param->key_order = NULL;
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            cparam_compile_free(param->key_list[key_idx].next_param);
+        }
+    }
+}
@@ -0,0 +1,364 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cparam.h"
+
+/* Used when there's no catalog, or it doesn't have the message. */
+static const char * const cparam_msg_default[CPARAM_MSG_LIM] = {
+    [CPARAM_MSG_MISSING_ARGUMENTS] = "Missing arguments.",
+    [CPARAM_MSG_NOT_INTEGER] = "Not a valid integer: \"%s\"",
+    [CPARAM_MSG_OUT_OF_RANGE] =
+        "Specified value %ld is not between %d and %d (inclusive).",
+    [CPARAM_MSG_KEYWORD_UNKNOWN] =
+        "Keyword \"%s\" is not in the keyword list.",
+    [CPARAM_MSG_KEYWORD_AMBIGUOUS] =
+        "Keyword \"%s\" matches too many keywords.",
+    [CPARAM_MSG_SUGGEST_FIRST] = " Did you mean \"%s\"",
+    [CPARAM_MSG_SUGGEST_NEXT] = " or \"%s\"",
+    [CPARAM_MSG_SUGGEST_END] = "?",
+    [CPARAM_MSG_KEY_UNKNOWN] = "Key \"%.*s\" is not in the key list.",
+    [CPARAM_MSG_KEY_AMBIGUOUS] = "Key \"%.*s\" matches too many keys.",
+    [CPARAM_MSG_KEY_PAST_MAX] = "Key \"%s\" is past the first 64 keys.",
+    [CPARAM_MSG_KEY_REPEATED] = "Key \"%s\" is given more than once.",
+    [CPARAM_MSG_KEY_NO_VALUE] = "Key \"%s\" doesn't take a value.",
+    [CPARAM_MSG_KEY_MISSING_VALUE] = "Missing value for key \"%s\".",
+    [CPARAM_MSG_KEY_BAD_VALUE_TYPE] = "Key \"%s\" value can't be parsed.",
+    [CPARAM_MSG_KEY_MISSING] = "Missing required key \"%s\".",
+    [CPARAM_MSG_NULL_PARAMETER] = "%s called with NULL %s%s%s parameter.",
+    [CPARAM_MSG_COMPILE_NO_MEMORY] =
+        "Out of memory compiling keywords for \"%s\".",
+    [CPARAM_MSG_FILE_OPEN] = "Could not open \"%s\": %s",
+    [CPARAM_MSG_FILE_READ] = "Could not read \"%s\": %s",
+    [CPARAM_MSG_FILE_MAP] = "Could not map \"%s\": %s",
+    [CPARAM_MSG_CONFIG_TOO_MANY] = "More than %d arguments.",
+    [CPARAM_MSG_CONFIG_NO_QUOTE] = "Missing closing quote.",
+    [CPARAM_MSG_CONFIG_NO_SPACE] = "Missing space after closing quote.",
+    [CPARAM_MSG_CONFIG_UNKNOWN] = "Unknown option \"%s\".",
+    [CPARAM_MSG_CONFIG_UNUSED] = "Unused argument \"%s\".",
+    [CPARAM_MSG_CATALOG_BAD] = "Not a valid message catalog: \"%s\"",
+    [CPARAM_MSG_USAGE_STRING] = "string",
+    [CPARAM_MSG_USAGE_INTEGER] = "integer",
+    [CPARAM_MSG_USAGE_KEYWORD] = "keyword",
+    [CPARAM_MSG_USAGE_KEYVAL] = "key=value",
+    [CPARAM_MSG_USAGE_ONE_OF] = "One of:",
+    [CPARAM_MSG_USAGE_ANY_OF] = "Any of:",
+    [CPARAM_MSG_USAGE_REQUIRED] = "(required)",
+    [CPARAM_MSG_CAPTURE_BAD] = "Not a valid capture: \"%s\"",
+    [CPARAM_MSG_PATTERN_MISMATCH] = "\"%s\" doesn't match \"%s\".",
+    [CPARAM_MSG_PATTERN_BAD] =
+        "Pattern \"%s\" is not valid at position %d.",
+    [CPARAM_MSG_PATTERN_COMPLEX] = "Pattern \"%s\" is too complex.",
+    [CPARAM_MSG_PATTERN_NO_MEMORY] =
+        "Out of memory compiling pattern \"%s\".",
+    [CPARAM_MSG_USAGE_PATTERN] = "pattern",
+    [CPARAM_MSG_USAGE_MATCHING] = "Matching:",
+    [CPARAM_MSG_ACTION_FAILED] = "Action failed.",
+    [CPARAM_MSG_PATTERN_NOT_COMPILED] = "Pattern \"%s\" is not compiled.",
+    [CPARAM_MSG_PATTERN_NULL] = "Pattern is NULL.",
+};
+
+/*
+    Chosen once at startup, before anything is parsed, so it isn't locked.
+ */
+static const struct cparam_catalog * cparam_catalog_current = NULL;
+
+static const uint32_t *
+cparam_catalog_offsets(const char * const map)
+{
+    return (const uint32_t *)((const struct cparam_catalog_header *)map + 1);
+}
+
+const char *
+cparam_msg(const unsigned int msg_id)
+{
+    const struct cparam_catalog * const catalog = cparam_catalog_current;
+    if (NULL != catalog)
+    {
+        const struct cparam_catalog_header * const header =
+            (const struct cparam_catalog_header *)catalog->map;
+        if (msg_id < header->msg_lim)
+        {
+            const uint32_t offset =
+                cparam_catalog_offsets(catalog->map)[msg_id];
+            if (0 != offset)
+            {
+                return catalog->map + offset;
+            }
+        }
+    }
+    if (msg_id < CPARAM_MSG_LIM)
+    {
+        return cparam_msg_default[msg_id];
+    }
+    return NULL;
+}
+
+void
+cparam_catalog_use(const struct cparam_catalog * const catalog)
+{
+    cparam_catalog_current = catalog;
+}
+
+size_t
+cparam_catalog_write(
+    const char * const msgs[],
+    const unsigned int msg_lim,
+    void * const buf,
+    const size_t buf_size
+) {
+    const size_t str_offset = sizeof(struct cparam_catalog_header)
+        + (size_t)msg_lim * sizeof(uint32_t);
+    size_t size = str_offset;
+    for (unsigned int msg_id = 0;msg_id < msg_lim;msg_id++)
+    {
+        if (NULL != msgs[msg_id])
+        {
+            size += strlen(msgs[msg_id]) + 1;
+        }
+    }
+    if (size > UINT32_MAX)
+    {
+        return 0;
+    }
+    if ((NULL == buf) || (buf_size < size))
+    {
+        return size;
+    }
+
+    struct cparam_catalog_header * const header = buf;
+    header->magic = CPARAM_CATALOG_MAGIC;
+    header->size = size;
+    header->msg_lim = msg_lim;
+    header->reserved = 0;
+    uint32_t * const offsets = (uint32_t *)(header + 1);
+    size_t offset = str_offset;
+    for (unsigned int msg_id = 0;msg_id < msg_lim;msg_id++)
+    {
+        offsets[msg_id] = 0;
+        if (NULL != msgs[msg_id])
+        {
+            const size_t msg_size = strlen(msgs[msg_id]) + 1;
+            memcpy((char *)buf + offset, msgs[msg_id], msg_size);
+            offsets[msg_id] = offset;
+            offset += msg_size;
+        }
+    }
+    return size;
+}
+
+/*
+    What a printf format expects for arguments: for each conversion, any "*"
+    and length modifiers, then the conversion character. A translation must
+    expect the same as the built in message, or printing it would read the
+    wrong arguments. Returns false if format has conversions that aren't
+    allowed, or too many to fit.
+ */
+static bool
+cparam_msg_format_args(
+    const char * const format,
+    char * const args,
+    const size_t args_size
+) {
+    size_t args_len = 0;
+    for (const char * fmt = format;'\0' != *fmt;fmt++)
+    {
+        if ('%' != *fmt)
+        {
+            continue;
+        }
+        fmt++;
+        if ('%' == *fmt)
+        {
+            continue;
+        }
+        for (;;fmt++)
+        {
+            if ('\0' == *fmt)
+            {
+                return false;
+            }
+            if (NULL != strchr("diouxXeEfFgGaAcs", *fmt))
+            {
+                break;
+            }
+            if (NULL == strchr("-+ #0123456789.*hlLqjzt", *fmt))
+            {
+                // Including "n", and "$" for reordering.
+                return false;
+            }
+            if (NULL != strchr("*hlLqjzt", *fmt))
+            {
+                if (args_len + 1 >= args_size)
+                {
+                    return false;
+                }
+                args[args_len++] = *fmt;
+            }
+        }
+        if (args_len + 2 >= args_size)
+        {
+            return false;
+        }
+        args[args_len++] = *fmt;
+        args[args_len++] = ',';
+    }
+    args[args_len] = '\0';
+    return true;
+}
+
+/*
+    Check everything the lookups depend on, so a damaged file can't make them
+    read outside the map or pass the wrong arguments to printf.
+ */
+static bool
+cparam_catalog_check(const char * const map, const size_t map_size)
+{
+    const struct cparam_catalog_header * const header =
+        (const struct cparam_catalog_header *)map;
+    if ( (map_size < sizeof(*header))
+      || (CPARAM_CATALOG_MAGIC != header->magic)
+      || (header->size != map_size)
+      || ( header->msg_lim
+        > (map_size - sizeof(*header)) / sizeof(uint32_t) ) )
+    {
+        return false;
+    }
+    const size_t str_offset =
+        sizeof(*header) + (size_t)header->msg_lim * sizeof(uint32_t);
+    const uint32_t * const offsets = cparam_catalog_offsets(map);
+    for (unsigned int msg_id = 0;msg_id < header->msg_lim;msg_id++)
+    {
+        const uint32_t offset = offsets[msg_id];
+        if (0 == offset)
+        {
+            continue;
+        }
+        if ( (offset < str_offset)
+          || (offset >= map_size)
+          || (NULL == memchr(map + offset, '\0', map_size - offset)) )
+        {
+            return false;
+        }
+        if ((msg_id >= CPARAM_MSG_LIM) || (NULL == cparam_msg_default[msg_id]))
+        {
+            /* Not one of ours. The library only uses the program's messages
+               (name_msg and desc_msg) as text, never as formats, so there's
+               nothing to check. */
+            continue;
+        }
+        char default_args[64];
+        char msg_args[64];
+        if ( !cparam_msg_format_args(
+                cparam_msg_default[msg_id],
+                default_args, sizeof(default_args)
+            )
+          || !cparam_msg_format_args(
+                map + offset, msg_args, sizeof(msg_args)
+            )
+          || (0 != strcmp(default_args, msg_args)) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+cparam_catalog_open(
+    struct cparam_catalog * const catalog,
+    const char * const file_name,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    catalog->map = NULL;
+    catalog->map_size = 0;
+
+    const int fd = open(file_name, O_RDONLY);
+    if (-1 == fd)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_OPEN), file_name, strerror(errno)
+            );
+        }
+        return false;
+    }
+    struct stat file_stat;
+    if (-1 == fstat(fd, &file_stat))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_READ), file_name, strerror(errno)
+            );
+        }
+        close(fd);
+        return false;
+    }
+    const size_t file_size = file_stat.st_size;
+    if (file_size < sizeof(struct cparam_catalog_header))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_CATALOG_BAD), file_name
+            );
+        }
+        close(fd);
+        return false;
+    }
+    /* Only read, so it can be shared with other processes using it. It's only
+       checked here, so it must be replaced (rename), never rewritten. */
+    const char * const map =
+        mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map)
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_FILE_MAP), file_name, strerror(errno)
+            );
+        }
+        close(fd);
+        return false;
+    }
+    close(fd);
+    if (!cparam_catalog_check(map, file_size))
+    {
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                cparam_msg(CPARAM_MSG_CATALOG_BAD), file_name
+            );
+        }
+        munmap((void *)map, file_size);
+        return false;
+    }
+
+    catalog->map = map;
+    catalog->map_size = file_size;
+    return true;
+}
+
+void
+cparam_catalog_close(struct cparam_catalog * const catalog)
+{
+    if (cparam_catalog_current == catalog)
+    {
+        cparam_catalog_current = NULL;
+    }
+    if (NULL != catalog->map)
+    {
+        munmap((void *)catalog->map, catalog->map_size);
+    }
+    catalog->map = NULL;
+    catalog->map_size = 0;
+}
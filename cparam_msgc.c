@@ -0,0 +1,213 @@
+/*
+    Compile a text message catalog for cparam_catalog_open().
+
+    Each line is a message id, a space, then the message. Lines starting with
+    "#" and empty lines are skipped. "\n", "\t" and "\\" in messages are
+    escapes. "cparam_msgc -t" prints the built in messages in this form, to
+    start a translation from.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cparam.h"
+
+static void print_usage(const char * cmd_name) {
+    printf("%s <text catalog> <compiled catalog>\n", cmd_name);
+    printf("%s -t\n", cmd_name);
+    printf("  -t: Print built in messages as a text catalog.\n");
+}
+
+static void print_template(void) {
+    for (unsigned int msg_id = 0;msg_id < CPARAM_MSG_LIM;msg_id++) {
+        const char * const msg = cparam_msg(msg_id);
+        if (NULL == msg) {
+            continue;
+        }
+        printf("%u ", msg_id);
+        for (const char * msg_ptr = msg;'\0' != *msg_ptr;msg_ptr++) {
+            switch (*msg_ptr) {
+            case '\n':
+                printf("\\n");
+                break;
+            case '\t':
+                printf("\\t");
+                break;
+            case '\\':
+                printf("\\\\");
+                break;
+            default:
+                putchar(*msg_ptr);
+                break;
+            }
+        }
+        printf("\n");
+    }
+}
+
+/* Undo escapes in place. Returns false for an unknown escape. */
+static bool unescape(char * const msg) {
+    char * out = msg;
+    for (const char * in = msg;'\0' != *in;in++) {
+        if ('\\' != *in) {
+            *out++ = *in;
+            continue;
+        }
+        in++;
+        switch (*in) {
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case '\\':
+            *out++ = '\\';
+            break;
+        default:
+            return false;
+        }
+    }
+    *out = '\0';
+    return true;
+}
+
+int main(const int argc, const char * const argv[]) {
+    if ((2 == argc) && (0 == strcmp("-t", argv[1]))) {
+        print_template();
+        exit(EXIT_SUCCESS);
+    }
+    if (3 != argc) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char * const in_name = argv[1];
+    const char * const out_name = argv[2];
+
+    FILE * const in_file = fopen(in_name, "r");
+    if (NULL == in_file) {
+        perror(in_name);
+        exit(EXIT_FAILURE);
+    }
+    // Indexed by message id, NULL if not given.
+    char ** msgs = NULL;
+    unsigned int msg_lim = 0;
+    char * line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len = 0;
+    int line_num = 0;
+    while (-1 != (line_len = getline(&line, &line_size, in_file))) {
+        line_num++;
+        if ((line_len > 0) && ('\n' == line[line_len - 1])) {
+            line[line_len - 1] = '\0';
+        }
+        if (('\0' == line[0]) || ('#' == line[0])) {
+            continue;
+        }
+        char * msg = NULL;
+        const unsigned long msg_id = strtoul(line, &msg, 10);
+        if ( (msg == line) || (' ' != *msg)
+          || (0 == msg_id) || (msg_id >= UINT16_MAX) )
+        {
+            printf("%s:%d: Expected message id and a space.\n",
+                in_name, line_num
+            );
+            exit(EXIT_FAILURE);
+        }
+        msg++;
+        if (!unescape(msg)) {
+            printf("%s:%d: Unknown escape.\n", in_name, line_num);
+            exit(EXIT_FAILURE);
+        }
+        if (msg_id >= msg_lim) {
+            const unsigned int new_lim = msg_id + 1;
+            msgs = realloc(msgs, new_lim * sizeof(msgs[0]));
+            if (NULL == msgs) {
+                printf("Out of memory.\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(&msgs[msg_lim], 0, (new_lim - msg_lim) * sizeof(msgs[0]));
+            msg_lim = new_lim;
+        }
+        if (NULL != msgs[msg_id]) {
+            printf("%s:%d: Message %lu is given more than once.\n",
+                in_name, line_num, msg_id
+            );
+            exit(EXIT_FAILURE);
+        }
+        msgs[msg_id] = strdup(msg);
+        if (NULL == msgs[msg_id]) {
+            printf("Out of memory.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(in_file);
+    free(line);
+
+    const size_t size =
+        cparam_catalog_write((const char * const *)msgs, msg_lim, NULL, 0);
+    // uint32_t for alignment.
+    uint32_t * const buf = malloc(size);
+    if ( (0 == size) || (NULL == buf)
+      || (size != cparam_catalog_write(
+            (const char * const *)msgs, msg_lim, buf, size
+        ))
+    ) {
+        printf("Could not build catalog.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Write a new file and rename it over the old one, never rewrite the old
+       one. Programs map the catalog they open and only check it then, so
+       changing it under them could crash them or give them unchecked
+       formats. */
+    static const char tmp_suffix[] = ".XXXXXX";
+    const size_t out_name_len = strlen(out_name);
+    char * const tmp_name = malloc(out_name_len + sizeof(tmp_suffix));
+    if (NULL == tmp_name) {
+        printf("Out of memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(tmp_name, out_name, out_name_len);
+    memcpy(tmp_name + out_name_len, tmp_suffix, sizeof(tmp_suffix));
+    const int tmp_fd = mkstemp(tmp_name);
+    if (-1 == tmp_fd) {
+        perror(tmp_name);
+        exit(EXIT_FAILURE);
+    }
+    // mkstemp() makes it private, make it like any other new file.
+    const mode_t mask = umask(0);
+    umask(mask);
+    FILE * const out_file = fdopen(tmp_fd, "wb");
+    if ( (NULL == out_file)
+      || (0 != fchmod(tmp_fd, 0666 & ~mask))
+      || (1 != fwrite(buf, size, 1, out_file))
+      || (0 != fclose(out_file))
+    ) {
+        perror(tmp_name);
+        remove(tmp_name);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Check it the same way it will be loaded. */
+    struct cparam_catalog catalog;
+    char err_msg[256];
+    if (!cparam_catalog_open(&catalog, tmp_name, err_msg, sizeof(err_msg))) {
+        printf("%s (does a message have the wrong %% arguments?)\n", err_msg);
+        remove(tmp_name);
+        exit(EXIT_FAILURE);
+    }
+    cparam_catalog_close(&catalog);
+    if (0 != rename(tmp_name, out_name)) {
+        perror(out_name);
+        remove(tmp_name);
+        exit(EXIT_FAILURE);
+    }
+    free(tmp_name);
+    exit(EXIT_SUCCESS);
+}
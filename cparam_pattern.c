@@ -0,0 +1,869 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cparam.h"
+#include "cparam_internal.h"
+
+/*
+    A pattern is parsed to a tree, the tree is turned into an NFA the way
+    Thompson (1968) does, and the NFA into a DFA by subset construction. Bytes
+    that every NFA state treats the same are merged into one class, so the
+    DFA table is states by classes instead of states by 256.
+ */
+
+/* Most nested groups. */
+#define CPARAM_PATTERN_DEPTH_MAX 32
+/* Largest count in {n,m}. */
+#define CPARAM_PATTERN_REPEAT_MAX 255
+#define CPARAM_NFA_STATE_MAX 512
+#define CPARAM_NFA_SET_WORDS (CPARAM_NFA_STATE_MAX / 64)
+
+enum cparam_pattern_kind {
+    CPARAM_PATTERN_EMPTY,
+    CPARAM_PATTERN_BYTES,
+    CPARAM_PATTERN_CAT,
+    CPARAM_PATTERN_ALT,
+    CPARAM_PATTERN_REPEAT,
+};
+
+struct cparam_pattern_node {
+    enum cparam_pattern_kind kind;
+    // For CPARAM_PATTERN_BYTES, bit for each byte that matches.
+    uint64_t bytes[4];
+    // For CPARAM_PATTERN_CAT and CPARAM_PATTERN_ALT, both. For
+    // CPARAM_PATTERN_REPEAT, left.
+    int left;
+    int right;
+    // For CPARAM_PATTERN_REPEAT, max is -1 if no limit.
+    int min;
+    int max;
+};
+
+enum cparam_pattern_error {
+    CPARAM_PATTERN_OK,
+    CPARAM_PATTERN_BAD,
+    CPARAM_PATTERN_COMPLEX,
+};
+
+struct cparam_pattern_parser {
+    const char * pattern;
+    size_t pos;
+    unsigned int depth;
+    struct cparam_pattern_node * nodes;
+    int node_lim;
+    int node_max;
+    enum cparam_pattern_error error;
+};
+
+/* Characters that are only literals when escaped. */
+static const char cparam_pattern_special[] = "\\.^$|?*+()[]{}";
+
+static inline void
+cparam_bytes_set(uint64_t bytes[4], const uint8_t c)
+{
+    bytes[c >> 6] |= UINT64_C(1) << (c & 63);
+}
+
+static inline bool
+cparam_bytes_has(const uint64_t bytes[4], const uint8_t c)
+{
+    return 0 != (bytes[c >> 6] & (UINT64_C(1) << (c & 63)));
+}
+
+static void
+cparam_bytes_range(uint64_t bytes[4], const int first, const int last)
+{
+    for (int c = first;c <= last;c++)
+    {
+        cparam_bytes_set(bytes, (uint8_t)c);
+    }
+}
+
+static int
+cparam_pattern_fail(
+    struct cparam_pattern_parser * const parser,
+    const enum cparam_pattern_error error
+) {
+    if (CPARAM_PATTERN_OK == parser->error)
+    {
+        parser->error = error;
+    }
+    return -1;
+}
+
+static int
+cparam_pattern_new(
+    struct cparam_pattern_parser * const parser,
+    const enum cparam_pattern_kind kind
+) {
+    if (parser->node_lim >= parser->node_max)
+    {
+        return cparam_pattern_fail(parser, CPARAM_PATTERN_COMPLEX);
+    }
+    struct cparam_pattern_node * const node = &parser->nodes[parser->node_lim];
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    return parser->node_lim++;
+}
+
+static int
+cparam_pattern_pair(
+    struct cparam_pattern_parser * const parser,
+    const enum cparam_pattern_kind kind,
+    const int left,
+    const int right
+) {
+    const int node_idx = cparam_pattern_new(parser, kind);
+    if (node_idx >= 0)
+    {
+        parser->nodes[node_idx].left = left;
+        parser->nodes[node_idx].right = right;
+    }
+    return node_idx;
+}
+
+/*
+    Add the bytes for the escape after a "\" to bytes. Only \d, \w, \s and
+    punctuation can be escaped.
+ */
+static bool
+cparam_pattern_escape(uint64_t bytes[4], const char c)
+{
+    switch (c)
+    {
+    case 'd':
+        cparam_bytes_range(bytes, '0', '9');
+        return true;
+    case 'w':
+        cparam_bytes_range(bytes, '0', '9');
+        cparam_bytes_range(bytes, 'A', 'Z');
+        cparam_bytes_range(bytes, 'a', 'z');
+        cparam_bytes_set(bytes, '_');
+        return true;
+    case 's':
+        cparam_bytes_set(bytes, ' ');
+        cparam_bytes_range(bytes, '\t', '\r');
+        return true;
+    }
+    if ( ('\0' == c)
+      || ((c >= '0') && (c <= '9'))
+      || ((c >= 'A') && (c <= 'Z'))
+      || ((c >= 'a') && (c <= 'z')) )
+    {
+        return false;
+    }
+    cparam_bytes_set(bytes, (uint8_t)c);
+    return true;
+}
+
+/* After the "[", up to and including the "]". */
+static int
+cparam_pattern_class(struct cparam_pattern_parser * const parser)
+{
+    const int node_idx = cparam_pattern_new(parser, CPARAM_PATTERN_BYTES);
+    if (node_idx < 0)
+    {
+        return -1;
+    }
+    uint64_t * const bytes = parser->nodes[node_idx].bytes;
+    const char * const pattern = parser->pattern;
+    bool negate = false;
+    if ('^' == pattern[parser->pos])
+    {
+        negate = true;
+        parser->pos++;
+    }
+    bool first = true;
+    while (first || (']' != pattern[parser->pos]))
+    {
+        first = false;
+        char c = pattern[parser->pos];
+        if ('\0' == c)
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+        }
+        parser->pos++;
+        if ('\\' == c)
+        {
+            c = pattern[parser->pos];
+            if (('\0' != c) && (NULL != strchr("dws", c)))
+            {
+                cparam_pattern_escape(bytes, c);
+                parser->pos++;
+                continue;
+            }
+            if (!cparam_pattern_escape(bytes, c))
+            {
+                return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+            }
+            parser->pos++;
+        }
+        if ( ('-' != pattern[parser->pos])
+          || (']' == pattern[parser->pos + 1])
+          || ('\0' == pattern[parser->pos + 1]) )
+        {
+            cparam_bytes_set(bytes, (uint8_t)c);
+            continue;
+        }
+        /* A range, "-" at the start or end is just a "-". */
+        parser->pos++;
+        char last = pattern[parser->pos];
+        parser->pos++;
+        if ('\\' == last)
+        {
+            last = pattern[parser->pos];
+            if ( (NULL != strchr("dws", last))
+              || !cparam_pattern_escape(bytes, last) )
+            {
+                return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+            }
+            parser->pos++;
+        }
+        if ((uint8_t)last < (uint8_t)c)
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+        }
+        cparam_bytes_range(bytes, (uint8_t)c, (uint8_t)last);
+    }
+    parser->pos++;
+    if (negate)
+    {
+        for (unsigned int word_idx = 0;word_idx < 4;word_idx++)
+        {
+            bytes[word_idx] = ~bytes[word_idx];
+        }
+    }
+    return node_idx;
+}
+
+static int cparam_pattern_alt(struct cparam_pattern_parser * const parser);
+
+static int
+cparam_pattern_atom(struct cparam_pattern_parser * const parser)
+{
+    const char c = parser->pattern[parser->pos];
+    if ('(' == c)
+    {
+        if (parser->depth >= CPARAM_PATTERN_DEPTH_MAX)
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_COMPLEX);
+        }
+        parser->pos++;
+        parser->depth++;
+        const int node_idx = cparam_pattern_alt(parser);
+        parser->depth--;
+        if (node_idx < 0)
+        {
+            return -1;
+        }
+        if (')' != parser->pattern[parser->pos])
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+        }
+        parser->pos++;
+        return node_idx;
+    }
+    if ('[' == c)
+    {
+        parser->pos++;
+        return cparam_pattern_class(parser);
+    }
+    if ( ('\\' != c) && ('.' != c)
+      && (NULL != strchr(cparam_pattern_special, c)) )
+    {
+        // Including "^", "$", and a repeat with nothing to repeat.
+        return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+    }
+    const int node_idx = cparam_pattern_new(parser, CPARAM_PATTERN_BYTES);
+    if (node_idx < 0)
+    {
+        return -1;
+    }
+    uint64_t * const bytes = parser->nodes[node_idx].bytes;
+    parser->pos++;
+    if ('.' == c)
+    {
+        bytes[0] = bytes[1] = bytes[2] = bytes[3] = ~UINT64_C(0);
+    }
+    else if ('\\' == c)
+    {
+        if (!cparam_pattern_escape(bytes, parser->pattern[parser->pos]))
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+        }
+        parser->pos++;
+    }
+    else
+    {
+        cparam_bytes_set(bytes, (uint8_t)c);
+    }
+    return node_idx;
+}
+
+/* Number for {n,m}, -1 if there isn't one. */
+static int
+cparam_pattern_count(struct cparam_pattern_parser * const parser)
+{
+    const char * const pattern = parser->pattern;
+    if ((pattern[parser->pos] < '0') || (pattern[parser->pos] > '9'))
+    {
+        return -1;
+    }
+    int count = 0;
+    while ((pattern[parser->pos] >= '0') && (pattern[parser->pos] <= '9'))
+    {
+        count = count * 10 + (pattern[parser->pos] - '0');
+        if (count > CPARAM_PATTERN_REPEAT_MAX)
+        {
+            return cparam_pattern_fail(parser, CPARAM_PATTERN_COMPLEX);
+        }
+        parser->pos++;
+    }
+    return count;
+}
+
+static int
+cparam_pattern_repeat(struct cparam_pattern_parser * const parser)
+{
+    int node_idx = cparam_pattern_atom(parser);
+    for (;;)
+    {
+        if (node_idx < 0)
+        {
+            return -1;
+        }
+        int min = 0;
+        int max = -1;
+        switch (parser->pattern[parser->pos])
+        {
+        case '*':
+            break;
+        case '+':
+            min = 1;
+            break;
+        case '?':
+            max = 1;
+            break;
+        case '{':
+            parser->pos++;
+            min = cparam_pattern_count(parser);
+            if (min < 0)
+            {
+                return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+            }
+            max = min;
+            if (',' == parser->pattern[parser->pos])
+            {
+                parser->pos++;
+                max = cparam_pattern_count(parser);
+                if (CPARAM_PATTERN_OK != parser->error)
+                {
+                    return -1;
+                }
+            }
+            if ( ('}' != parser->pattern[parser->pos])
+              || ((max >= 0) && (max < min)) )
+            {
+                return cparam_pattern_fail(parser, CPARAM_PATTERN_BAD);
+            }
+            break;
+        default:
+            return node_idx;
+        }
+        parser->pos++;
+        const int repeat_idx =
+            cparam_pattern_new(parser, CPARAM_PATTERN_REPEAT);
+        if (repeat_idx >= 0)
+        {
+            parser->nodes[repeat_idx].left = node_idx;
+            parser->nodes[repeat_idx].min = min;
+            parser->nodes[repeat_idx].max = max;
+        }
+        node_idx = repeat_idx;
+    }
+}
+
+static int
+cparam_pattern_cat(struct cparam_pattern_parser * const parser)
+{
+    int node_idx = cparam_pattern_new(parser, CPARAM_PATTERN_EMPTY);
+    for (;;)
+    {
+        const char c = parser->pattern[parser->pos];
+        if ((node_idx < 0) || ('\0' == c) || ('|' == c) || (')' == c))
+        {
+            return node_idx;
+        }
+        const int right_idx = cparam_pattern_repeat(parser);
+        if (right_idx < 0)
+        {
+            return -1;
+        }
+        node_idx = cparam_pattern_pair(
+            parser, CPARAM_PATTERN_CAT, node_idx, right_idx
+        );
+    }
+}
+
+static int
+cparam_pattern_alt(struct cparam_pattern_parser * const parser)
+{
+    int node_idx = cparam_pattern_cat(parser);
+    while ((node_idx >= 0) && ('|' == parser->pattern[parser->pos]))
+    {
+        parser->pos++;
+        const int right_idx = cparam_pattern_cat(parser);
+        if (right_idx < 0)
+        {
+            return -1;
+        }
+        node_idx = cparam_pattern_pair(
+            parser, CPARAM_PATTERN_ALT, node_idx, right_idx
+        );
+    }
+    return node_idx;
+}
+
+enum cparam_nfa_kind {
+    CPARAM_NFA_BYTES,
+    CPARAM_NFA_SPLIT,
+    CPARAM_NFA_MATCH,
+};
+
+struct cparam_nfa_state {
+    enum cparam_nfa_kind kind;
+    // For CPARAM_NFA_BYTES, the bytes that go to out.
+    const uint64_t * bytes;
+    int out;
+    // For CPARAM_NFA_SPLIT, the other way to go.
+    int out_alt;
+};
+
+struct cparam_nfa {
+    const struct cparam_pattern_node * nodes;
+    struct cparam_nfa_state states[CPARAM_NFA_STATE_MAX];
+    int state_lim;
+};
+
+static int
+cparam_nfa_new(
+    struct cparam_nfa * const nfa,
+    const enum cparam_nfa_kind kind,
+    const int out,
+    const int out_alt
+) {
+    if (nfa->state_lim >= CPARAM_NFA_STATE_MAX)
+    {
+        return -1;
+    }
+    struct cparam_nfa_state * const state = &nfa->states[nfa->state_lim];
+    state->kind = kind;
+    state->bytes = NULL;
+    state->out = out;
+    state->out_alt = out_alt;
+    return nfa->state_lim++;
+}
+
+/*
+    States for node that go on to state next, built back to front so each
+    one's out is known when it's made. Returns the first, or -1 if there are
+    too many.
+ */
+static int
+cparam_nfa_build(struct cparam_nfa * const nfa, const int node_idx, int next)
+{
+    const struct cparam_pattern_node * const node = &nfa->nodes[node_idx];
+    if (next < 0)
+    {
+        return -1;
+    }
+    switch (node->kind)
+    {
+    case CPARAM_PATTERN_EMPTY:
+        return next;
+    case CPARAM_PATTERN_BYTES:
+        {
+            const int state_idx =
+                cparam_nfa_new(nfa, CPARAM_NFA_BYTES, next, -1);
+            if (state_idx >= 0)
+            {
+                nfa->states[state_idx].bytes = node->bytes;
+            }
+            return state_idx;
+        }
+    case CPARAM_PATTERN_CAT:
+        return cparam_nfa_build(
+            nfa, node->left, cparam_nfa_build(nfa, node->right, next)
+        );
+    case CPARAM_PATTERN_ALT:
+        {
+            const int left = cparam_nfa_build(nfa, node->left, next);
+            const int right = cparam_nfa_build(nfa, node->right, next);
+            if ((left < 0) || (right < 0))
+            {
+                return -1;
+            }
+            return cparam_nfa_new(nfa, CPARAM_NFA_SPLIT, left, right);
+        }
+    case CPARAM_PATTERN_REPEAT:
+        {
+            int start = next;
+            if (node->max < 0)
+            {
+                /* Loop back to a split that either repeats or goes on. */
+                const int loop_idx =
+                    cparam_nfa_new(nfa, CPARAM_NFA_SPLIT, -1, next);
+                if (loop_idx < 0)
+                {
+                    return -1;
+                }
+                nfa->states[loop_idx].out =
+                    cparam_nfa_build(nfa, node->left, loop_idx);
+                if (nfa->states[loop_idx].out < 0)
+                {
+                    return -1;
+                }
+                start = loop_idx;
+            }
+            else
+            {
+                /* Each optional copy can skip the rest. */
+                for (int copy_idx = node->min;copy_idx < node->max;copy_idx++)
+                {
+                    const int copy = cparam_nfa_build(nfa, node->left, start);
+                    start = cparam_nfa_new(nfa, CPARAM_NFA_SPLIT, copy, next);
+                    if ((copy < 0) || (start < 0))
+                    {
+                        return -1;
+                    }
+                }
+            }
+            for (int copy_idx = 0;copy_idx < node->min;copy_idx++)
+            {
+                start = cparam_nfa_build(nfa, node->left, start);
+            }
+            return start;
+        }
+    }
+    return -1;
+}
+
+/* Add state_idx and everything reachable from it without a byte to set. */
+static void
+cparam_nfa_closure(
+    const struct cparam_nfa * const nfa,
+    uint64_t set[CPARAM_NFA_SET_WORDS],
+    const int state_idx
+) {
+    // A state can be pushed once for each edge into it.
+    int stack[CPARAM_NFA_STATE_MAX * 2 + 1];
+    int stack_lim = 0;
+    stack[stack_lim++] = state_idx;
+    while (stack_lim > 0)
+    {
+        const int current = stack[--stack_lim];
+        const uint64_t bit = UINT64_C(1) << (current & 63);
+        if (0 != (set[current >> 6] & bit))
+        {
+            continue;
+        }
+        set[current >> 6] |= bit;
+        if (CPARAM_NFA_SPLIT == nfa->states[current].kind)
+        {
+            stack[stack_lim++] = nfa->states[current].out_alt;
+            stack[stack_lim++] = nfa->states[current].out;
+        }
+    }
+}
+
+/*
+    Split bytes into classes so that every NFA state either has all of a
+    class or none of it. Returns the number of classes.
+ */
+static unsigned int
+cparam_nfa_classes(
+    const struct cparam_nfa * const nfa,
+    uint8_t byte_class[256],
+    uint8_t class_byte[256]
+) {
+    unsigned int class_lim = 1;
+    memset(byte_class, 0, 256);
+    for (int state_idx = 0;state_idx < nfa->state_lim;state_idx++)
+    {
+        const struct cparam_nfa_state * const state = &nfa->states[state_idx];
+        if (CPARAM_NFA_BYTES != state->kind)
+        {
+            continue;
+        }
+        /* New class for (old class, in bytes), numbered as first seen. */
+        int16_t split[256][2];
+        memset(split, -1, sizeof(split));
+        unsigned int new_lim = 0;
+        for (unsigned int c = 0;c < 256;c++)
+        {
+            const int has = cparam_bytes_has(state->bytes, (uint8_t)c);
+            int16_t * const new_class = &split[byte_class[c]][has];
+            if (*new_class < 0)
+            {
+                *new_class = (int16_t)new_lim++;
+            }
+            byte_class[c] = (uint8_t)*new_class;
+        }
+        class_lim = new_lim;
+    }
+    for (int c = 255;c >= 0;c--)
+    {
+        class_byte[byte_class[c]] = (uint8_t)c;
+    }
+    return class_lim;
+}
+
+static void
+cparam_pattern_error_msg(
+    const char * const pattern,
+    const enum cparam_pattern_error error,
+    const size_t pos,
+    unsigned int * const msg_id,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    *msg_id = (CPARAM_PATTERN_BAD == error)
+        ? CPARAM_MSG_PATTERN_BAD
+        : CPARAM_MSG_PATTERN_COMPLEX;
+    if (NULL == err_msg)
+    {
+        return;
+    }
+    if (CPARAM_PATTERN_BAD == error)
+    {
+        snprintf(err_msg, err_msg_size,
+            cparam_msg(CPARAM_MSG_PATTERN_BAD), pattern, (int)pos + 1
+        );
+    }
+    else
+    {
+        snprintf(err_msg, err_msg_size,
+            cparam_msg(CPARAM_MSG_PATTERN_COMPLEX), pattern
+        );
+    }
+}
+
+static bool
+cparam_pattern_no_memory(
+    const char * const pattern,
+    unsigned int * const msg_id,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    *msg_id = CPARAM_MSG_PATTERN_NO_MEMORY;
+    if (NULL != err_msg)
+    {
+        snprintf(err_msg, err_msg_size,
+            cparam_msg(CPARAM_MSG_PATTERN_NO_MEMORY), pattern
+        );
+    }
+    return false;
+}
+
+bool
+cparam_pattern_compile(
+    const char * const pattern,
+    struct cparam_dfa ** const dfa_out,
+    unsigned int * const msg_id,
+    char * const err_msg,
+    const size_t err_msg_size
+) {
+    *dfa_out = NULL;
+    if (NULL == pattern)
+    {
+        *msg_id = CPARAM_MSG_PATTERN_NULL;
+        if (NULL != err_msg)
+        {
+            snprintf(err_msg, err_msg_size,
+                "%s", cparam_msg(CPARAM_MSG_PATTERN_NULL)
+            );
+        }
+        return false;
+    }
+
+    /* Each character makes at most two nodes, one for itself and one to
+       join it to what's before. */
+    const size_t pattern_len = strlen(pattern);
+    if (pattern_len > CPARAM_NFA_STATE_MAX)
+    {
+        cparam_pattern_error_msg(pattern, CPARAM_PATTERN_COMPLEX, 0,
+            msg_id, err_msg, err_msg_size
+        );
+        return false;
+    }
+    struct cparam_pattern_parser parser = {
+        .pattern = pattern,
+        .pos = 0,
+        .depth = 0,
+        .nodes = NULL,
+        .node_lim = 0,
+        .node_max = (int)pattern_len * 2 + 2,
+        .error = CPARAM_PATTERN_OK,
+    };
+    parser.nodes = malloc(parser.node_max * sizeof(parser.nodes[0]));
+    struct cparam_nfa * const nfa = malloc(sizeof(*nfa));
+    /* NFA state set of each DFA state. */
+    uint64_t (* const sets)[CPARAM_NFA_SET_WORDS] =
+        malloc(CPARAM_DFA_STATE_MAX * sizeof(sets[0]));
+    if ((NULL == parser.nodes) || (NULL == nfa) || (NULL == sets))
+    {
+        free(parser.nodes);
+        free(nfa);
+        free(sets);
+        return cparam_pattern_no_memory(
+            pattern, msg_id, err_msg, err_msg_size
+        );
+    }
+
+    const int root_idx = cparam_pattern_alt(&parser);
+    if ((root_idx >= 0) && ('\0' != pattern[parser.pos]))
+    {
+        // Only a ")" stops before the end.
+        cparam_pattern_fail(&parser, CPARAM_PATTERN_BAD);
+    }
+    int nfa_start = -1;
+    if (CPARAM_PATTERN_OK == parser.error)
+    {
+        nfa->nodes = parser.nodes;
+        nfa->state_lim = 0;
+        nfa_start = cparam_nfa_build(
+            nfa, root_idx, cparam_nfa_new(nfa, CPARAM_NFA_MATCH, -1, -1)
+        );
+        if (nfa_start < 0)
+        {
+            parser.error = CPARAM_PATTERN_COMPLEX;
+        }
+    }
+    if (CPARAM_PATTERN_OK != parser.error)
+    {
+        cparam_pattern_error_msg(pattern, parser.error, parser.pos,
+            msg_id, err_msg, err_msg_size
+        );
+        free(parser.nodes);
+        free(nfa);
+        free(sets);
+        return false;
+    }
+
+    uint8_t byte_class[256];
+    uint8_t class_byte[256];
+    const unsigned int class_lim =
+        cparam_nfa_classes(nfa, byte_class, class_byte);
+    /* Table for every state that could be needed, shrunk at the end. */
+    struct cparam_dfa * dfa = malloc(
+        sizeof(*dfa) + (size_t)CPARAM_DFA_STATE_MAX * class_lim
+    );
+    if (NULL == dfa)
+    {
+        free(parser.nodes);
+        free(nfa);
+        free(sets);
+        return cparam_pattern_no_memory(
+            pattern, msg_id, err_msg, err_msg_size
+        );
+    }
+    memcpy(dfa->byte_class, byte_class, sizeof(dfa->byte_class));
+    dfa->class_lim = class_lim;
+
+    /* State 0 has no NFA states, so it never matches and never leaves. */
+    memset(sets[0], 0, sizeof(sets[0]));
+    memset(sets[1], 0, sizeof(sets[1]));
+    cparam_nfa_closure(nfa, sets[1], nfa_start);
+    unsigned int state_lim = 2;
+    dfa->start = 1;
+    bool too_complex = false;
+    for (unsigned int state_idx = 0;
+        (state_idx < state_lim) && !too_complex;
+        state_idx++)
+    {
+        dfa->accept[state_idx] = 0;
+        for (unsigned int class_idx = 0;class_idx < class_lim;class_idx++)
+        {
+            const uint8_t c = class_byte[class_idx];
+            uint64_t next_set[CPARAM_NFA_SET_WORDS];
+            memset(next_set, 0, sizeof(next_set));
+            for (int nfa_idx = 0;nfa_idx < nfa->state_lim;nfa_idx++)
+            {
+                if (0 == (sets[state_idx][nfa_idx >> 6]
+                    & (UINT64_C(1) << (nfa_idx & 63))))
+                {
+                    continue;
+                }
+                const struct cparam_nfa_state * const state =
+                    &nfa->states[nfa_idx];
+                if (CPARAM_NFA_MATCH == state->kind)
+                {
+                    dfa->accept[state_idx] = 1;
+                }
+                else if ( (CPARAM_NFA_BYTES == state->kind)
+                  && cparam_bytes_has(state->bytes, c) )
+                {
+                    cparam_nfa_closure(nfa, next_set, state->out);
+                }
+            }
+            unsigned int next_idx = 0;
+            while ( (next_idx < state_lim)
+              && (0 != memcmp(sets[next_idx], next_set, sizeof(next_set))) )
+            {
+                next_idx++;
+            }
+            if (next_idx == state_lim)
+            {
+                if (state_lim >= CPARAM_DFA_STATE_MAX)
+                {
+                    too_complex = true;
+                    break;
+                }
+                memcpy(sets[state_lim], next_set, sizeof(next_set));
+                state_lim++;
+            }
+            dfa->next[state_idx * class_lim + class_idx] = (uint8_t)next_idx;
+        }
+    }
+    free(parser.nodes);
+    free(nfa);
+    free(sets);
+    if (too_complex)
+    {
+        free(dfa);
+        cparam_pattern_error_msg(pattern, CPARAM_PATTERN_COMPLEX, 0,
+            msg_id, err_msg, err_msg_size
+        );
+        return false;
+    }
+    dfa->state_lim = state_lim;
+    struct cparam_dfa * const dfa_small =
+        realloc(dfa, sizeof(*dfa) + (size_t)state_lim * class_lim);
+    *dfa_out = (NULL != dfa_small) ? dfa_small : dfa;
+    return true;
+}
+
+/* Whether all of arg matches, one table lookup per byte. */
+bool
+cparam_pattern_match(
+    const struct cparam_dfa * const dfa,
+    const char * const arg,
+    const size_t arg_len
+) {
+    const unsigned int class_lim = dfa->class_lim;
+    unsigned int state_idx = dfa->start;
+    for (size_t arg_idx = 0;arg_idx < arg_len;arg_idx++)
+    {
+        state_idx = dfa->next[
+            state_idx * class_lim + dfa->byte_class[(uint8_t)arg[arg_idx]]
+        ];
+        if (0 == state_idx)
+        {
+            return false;
+        }
+    }
+    return 0 != dfa->accept[state_idx];
+}
@@ -0,0 +1,308 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cparam.h"
+#include "cparam_trace.h"
+
+/*
+    Help printing, kept apart from parsing so that programs that don't print
+    help, or are built with CPARAM_REALTIME, don't link stdio for it.
+ */
+
+static void
+cparam_indent(const unsigned int indent_level)
+{
+    for (unsigned int indent_cnt = 0;indent_cnt < indent_level;indent_cnt++)
+    {
+        printf("  ");
+    }
+}
+
+/* Text of msg_id in the message catalog if it has one, otherwise text. */
+static const char *
+cparam_text(const unsigned int msg_id, const char * const text)
+{
+    if (0 != msg_id)
+    {
+        const char * const msg = cparam_msg(msg_id);
+        if (NULL != msg)
+        {
+            return msg;
+        }
+    }
+    return text;
+}
+
+static bool
+cparam_has_more_lines(
+    const struct cparam_info * const start_param
+) {
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        const char * const desc = cparam_text(param->desc_msg, param->desc);
+        if ((NULL != desc) && ('\0' != desc[0])) {
+            // Has a description.
+            return true;
+        }
+        if ( (CPARAM_KEYWORD == param->type)
+          || (CPARAM_KEYVAL == param->type)
+          || (CPARAM_PATTERN == param->type) )
+        {
+            // Has keyword in list, or pattern.
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+cparam_print_parameters(
+    const struct cparam_info * const start_param,
+    unsigned int indent_level
+) {
+    /* First list the paramers. */
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        const char * const param_name =
+            cparam_text(param->name_msg, param->name);
+        const bool has_name = (NULL != param_name) && ('\0' != param_name[0]);
+        const char * const name = has_name ? param_name : "";
+        const char * const sep = has_name ? ":" : "";
+
+        switch (param->type)
+        {
+        case CPARAM_STRING:
+            printf("<%s%s%s> ", name, sep, cparam_msg(CPARAM_MSG_USAGE_STRING));
+            break;
+        case CPARAM_PATTERN:
+            printf("<%s%s%s> ",
+                name, sep, cparam_msg(CPARAM_MSG_USAGE_PATTERN)
+            );
+            break;
+        case CPARAM_INT:
+            if (param->has_range)
+            {
+                printf("<%s%s%d-%d> ",
+                    name, sep, param->int_val_min, param->int_val_max
+                );
+            }
+            else
+            {
+                printf("<%s%s%s> ",
+                    name, sep, cparam_msg(CPARAM_MSG_USAGE_INTEGER)
+                );
+            }
+            break;
+        case CPARAM_KEYWORD:
+            if (has_name)
+            {
+                printf("<%s> ", name);
+            }
+            else
+            {
+                printf("<%s> ", cparam_msg(CPARAM_MSG_USAGE_KEYWORD));
+            }
+            break;
+        case CPARAM_ACTION:
+            // No corresponding argument.
+            break;
+        case CPARAM_KEYVAL:
+            if (has_name)
+            {
+                printf("<%s> ", name);
+            }
+            else
+            {
+                printf("<%s ...> ", cparam_msg(CPARAM_MSG_USAGE_KEYVAL));
+            }
+            break;
+        }
+    }
+}
+
+static void
+cparam_print_main(
+    const struct cparam_info * const start_param,
+    unsigned int indent_level
+) {
+    if (!cparam_has_more_lines(start_param)) {
+        return;
+    }
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = param->next_param )
+    {
+        const char * const desc = cparam_text(param->desc_msg, param->desc);
+        const bool has_desc = (NULL != desc) && ('\0' != desc[0]);
+        if ( has_desc
+          || (CPARAM_KEYWORD == param->type)
+          || (CPARAM_KEYVAL == param->type)
+          || (CPARAM_PATTERN == param->type) )
+        {
+            const char * const param_name =
+                cparam_text(param->name_msg, param->name);
+            const bool has_name =
+                (NULL != param_name) && ('\0' != param_name[0]);
+            /* Print name first. */
+            const char * name = "";
+            if (has_name)
+            {
+                name = param_name;
+            }
+            else
+            {
+                switch (param->type)
+                {
+                case CPARAM_STRING:
+                    name = cparam_msg(CPARAM_MSG_USAGE_STRING);
+                    break;
+                case CPARAM_PATTERN:
+                    name = cparam_msg(CPARAM_MSG_USAGE_PATTERN);
+                    break;
+                case CPARAM_INT:
+                    name = cparam_msg(CPARAM_MSG_USAGE_INTEGER);
+                    break;
+                case CPARAM_KEYWORD:
+                    name = cparam_msg(CPARAM_MSG_USAGE_KEYWORD);
+                    break;
+                case CPARAM_KEYVAL:
+                    name = cparam_msg(CPARAM_MSG_USAGE_KEYVAL);
+                    break;
+                case CPARAM_ACTION:
+                    // Shouldn't get here
+                    break;
+                }
+            }
+            cparam_indent(indent_level + 1);
+            if (param->has_range)
+            {
+                if (has_name)
+                {
+                    printf("<%s:%d-%d>:",
+                        name, param->int_val_min, param->int_val_max
+                    );
+                }
+                else
+                {
+                    printf("<%d-%d>:",
+                        param->int_val_min, param->int_val_max
+                    );
+                }
+            }
+            else
+            {
+                printf("<%s>:", name);
+            }
+
+            /* Print additional information - description, keyword list. */
+            if (has_desc)
+            {
+                printf(" %s", desc);
+            }
+            if ((CPARAM_PATTERN == param->type) && (NULL != param->pattern))
+            {
+                printf(" %s %s",
+                    cparam_msg(CPARAM_MSG_USAGE_MATCHING), param->pattern
+                );
+            }
+            if (CPARAM_KEYWORD == param->type)
+            {
+                const int key_lim = param->key_lim;
+                bool has_next_param = false;
+                for (int key_idx = 0;key_idx < key_lim;key_idx++)
+                {
+                    const struct cparam_keyword_info * key =
+                        &param->key_list[key_idx];
+                    if (NULL != key->next_param)
+                    {
+                        has_next_param = true;
+                    }
+                }
+                printf(" %s \n", cparam_msg(CPARAM_MSG_USAGE_ONE_OF));
+                /* If any keyword has more parameters, print one per line,
+                   otherwise print all on one line. */
+                if (!has_next_param)
+                {
+                    cparam_indent(indent_level + 2);
+                    for (int key_idx = 0;key_idx < key_lim;key_idx++)
+                    {
+                        const struct cparam_keyword_info * key =
+                            &param->key_list[key_idx];
+                        printf("%s ", key->name);
+                    }
+                }
+                else
+                {
+                    for (int key_idx = 0;key_idx < key_lim;key_idx++)
+                    {
+                        const struct cparam_keyword_info * key =
+                            &param->key_list[key_idx];
+                        const struct cparam_info * const next_param =
+                            key->next_param;
+                        cparam_indent(indent_level + 2);
+                        printf("%s ", key->name);
+                        cparam_print_parameters(next_param, indent_level);
+                        printf("\n");
+                        cparam_print_main(next_param, indent_level + 2);
+                    }
+                }
+            }
+            if (CPARAM_KEYVAL == param->type)
+            {
+                /* One key per line, with its value. */
+                printf(" %s \n", cparam_msg(CPARAM_MSG_USAGE_ANY_OF));
+                for (unsigned int key_idx = 0;
+                    key_idx < param->key_lim;
+                    key_idx++)
+                {
+                    const struct cparam_keyword_info * key =
+                        &param->key_list[key_idx];
+                    const struct cparam_info * const next_param =
+                        key->next_param;
+                    cparam_indent(indent_level + 2);
+                    if (NULL == next_param)
+                    {
+                        printf("%s ", key->name);
+                    }
+                    else
+                    {
+                        printf("%s=", key->name);
+                        cparam_print_parameters(next_param, indent_level);
+                    }
+                    if ( (key_idx < 64)
+                      && (0 != (param->key_required
+                        & CPARAM_KEY_BIT(key_idx))) )
+                    {
+                        printf("%s", cparam_msg(CPARAM_MSG_USAGE_REQUIRED));
+                    }
+                    printf("\n");
+                    cparam_print_main(next_param, indent_level + 2);
+                }
+            }
+            printf("\n");
+        }
+    }
+}
+
+void
+cparam_print_param_names(const struct cparam_info * const start_param) {
+    CPARAM_TRACE_BEGIN(print_start_ns);
+    cparam_print_parameters(start_param, 0);
+    CPARAM_TRACE_END(print_start_ns, "print_param_names",
+        (NULL != start_param) ? start_param->name : NULL
+    );
+}
+
+void
+cparam_print(const struct cparam_info * const start_param) {
+    CPARAM_TRACE_BEGIN(print_start_ns);
+    cparam_print_main(start_param, 1);
+    CPARAM_TRACE_END(print_start_ns, "print",
+        (NULL != start_param) ? start_param->name : NULL
+    );
+}
+
@@ -0,0 +1,95 @@
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cparam.h"
+#include "cparam_rcu.h"
+
+/*
+    All atomic operations here are sequentially consistent, which is what makes
+    this work: a reader that saw the old grammar pointer must have set its
+    active epoch before the writer incremented the epoch, so the writer will
+    see it and wait.
+ */
+
+struct cparam_rcu_reader *
+cparam_rcu_register(struct cparam_rcu * const rcu)
+{
+    for (unsigned int reader_idx = 0;
+        reader_idx < CPARAM_RCU_READER_MAX;
+        reader_idx++)
+    {
+        struct cparam_rcu_reader * const reader = &rcu->readers[reader_idx];
+        bool used = false;
+        if (atomic_compare_exchange_strong(&reader->used, &used, true))
+        {
+            atomic_store(&reader->active, 0);
+            return reader;
+        }
+    }
+    return NULL;
+}
+
+void
+cparam_rcu_unregister(struct cparam_rcu_reader * const reader)
+{
+    atomic_store(&reader->active, 0);
+    atomic_store(&reader->used, false);
+}
+
+void
+cparam_rcu_read_lock(
+    struct cparam_rcu * const rcu,
+    struct cparam_rcu_reader * const reader
+) {
+    atomic_store(&reader->active, atomic_load(&rcu->epoch) + 1);
+}
+
+void
+cparam_rcu_read_unlock(struct cparam_rcu_reader * const reader)
+{
+    atomic_store(&reader->active, 0);
+}
+
+void
+cparam_rcu_synchronize(struct cparam_rcu * const rcu)
+{
+    /* Any reader that started before this has active <= new epoch. */
+    const unsigned long epoch = atomic_fetch_add(&rcu->epoch, 1) + 1;
+    for (unsigned int reader_idx = 0;
+        reader_idx < CPARAM_RCU_READER_MAX;
+        reader_idx++)
+    {
+        struct cparam_rcu_reader * const reader = &rcu->readers[reader_idx];
+        for (;;)
+        {
+            const unsigned long active = atomic_load(&reader->active);
+            if ((0 == active) || (active > epoch))
+            {
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+struct cparam_info *
+cparam_grammar_get(struct cparam_grammar * const grammar)
+{
+    return atomic_load(&grammar->start_param);
+}
+
+struct cparam_info *
+cparam_grammar_publish(
+    struct cparam_grammar * const grammar,
+    struct cparam_info * const start_param
+) {
+    /* Before the swap, so a cache that gets the new grammar doesn't use
+       entries from before it. */
+    atomic_fetch_add(&grammar->generation, 1);
+    struct cparam_info * const old_start_param =
+        atomic_exchange(&grammar->start_param, start_param);
+    cparam_rcu_synchronize(grammar->rcu);
+    return old_start_param;
+}
@@ -0,0 +1,61 @@
+#ifndef CPARAM_RCU_H
+#define CPARAM_RCU_H
+/*
+    Grammar that can be replaced while another thread is parsing with it.
+
+    The parsing thread reads the current grammar without locking. A new
+    grammar is published by swapping a pointer, and the old one is handed back
+    once no thread can still be using it (read-copy-update, using epochs to
+    tell when readers are done).
+
+    Parsed values are stored in the grammar's cparam_info structs, so a grammar
+    can't be shared by parsing threads. Each one needs a grammar and a struct
+    cparam_grammar of its own, only the struct cparam_rcu can be shared.
+ */
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "cparam.h"
+
+#ifndef CPARAM_RCU_READER_MAX
+#define CPARAM_RCU_READER_MAX 64
+#endif
+
+struct cparam_rcu_reader {
+    atomic_bool used;
+    // 0 if not reading, otherwise epoch + 1 when reading started.
+    atomic_ulong active;
+};
+
+/* Zero initialise, such as with a static variable or {0}. */
+struct cparam_rcu {
+    atomic_ulong epoch;
+    struct cparam_rcu_reader readers[CPARAM_RCU_READER_MAX];
+};
+
+struct cparam_grammar {
+    struct cparam_rcu * const rcu;
+    _Atomic(struct cparam_info *) start_param;
+    // Moved on by each publish, for CPARAM_CACHE_INIT_GRAMMAR().
+    atomic_ulong generation;
+};
+
+#define CPARAM_GRAMMAR_INIT(rcu, start_param) \
+    {rcu, start_param, 0}
+
+struct cparam_rcu_reader * cparam_rcu_register(struct cparam_rcu * const rcu);
+void cparam_rcu_unregister(struct cparam_rcu_reader * const reader);
+void cparam_rcu_read_lock(
+    struct cparam_rcu * const rcu,
+    struct cparam_rcu_reader * const reader
+);
+void cparam_rcu_read_unlock(struct cparam_rcu_reader * const reader);
+void cparam_rcu_synchronize(struct cparam_rcu * const rcu);
+
+struct cparam_info * cparam_grammar_get(struct cparam_grammar * const grammar);
+struct cparam_info * cparam_grammar_publish(
+    struct cparam_grammar * const grammar,
+    struct cparam_info * const start_param
+);
+
+#endif  // CPARAM_RCU_H
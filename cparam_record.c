@@ -0,0 +1,236 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cparam.h"
+
+/*
+    For a CPARAM_KEYVAL key that was given, the parameter holding its value, or
+    param itself if the key is a flag. NULL if the key wasn't given.
+ */
+static const struct cparam_info *
+cparam_record_key_value(
+    const struct cparam_info * const param,
+    const unsigned int key_idx
+) {
+    if ( (key_idx >= 64)
+      || (0 == (param->key_seen & CPARAM_KEY_BIT(key_idx))) )
+    {
+        return NULL;
+    }
+    const struct cparam_info * const value_param =
+        param->key_list[key_idx].next_param;
+    return (NULL != value_param) ? value_param : param;
+}
+
+static void
+cparam_record_fill(
+    struct cparam_record_node * const node,
+    const uint16_t node_id,
+    const struct cparam_info * const param,
+    char * const str_start,
+    const size_t str_offset,
+    size_t * const str_len_total
+) {
+    node->node_id = node_id;
+    node->type = param->type;
+    node->flags = 0;
+    node->key_idx = (CPARAM_KEYWORD == param->type) ? param->key_idx : -1;
+    node->int_val =
+        ((CPARAM_INT == param->type) || (CPARAM_KEYWORD == param->type))
+            ? param->int_val
+            : 0;
+    node->str_offset = 0;
+    node->str_len = 0;
+    if ((CPARAM_ACTION != param->type) && (NULL != param->str_val))
+    {
+        const size_t str_len = strlen(param->str_val);
+        memcpy(str_start + *str_len_total, param->str_val, str_len + 1);
+        node->flags |= CPARAM_RECORD_HAS_STR;
+        node->str_offset = str_offset + *str_len_total;
+        node->str_len = str_len;
+        *str_len_total += str_len + 1;
+    }
+}
+
+size_t
+cparam_record_write(
+    const struct cparam_info * const start_param,
+    void * const buf,
+    const size_t buf_size
+) {
+    /* Count first, to find where the strings start and the total size. */
+    size_t node_lim = 0;
+    size_t str_size = 0;
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = cparam_next((struct cparam_info *)param) )
+    {
+        node_lim++;
+        if ((CPARAM_ACTION != param->type) && (NULL != param->str_val))
+        {
+            str_size += strlen(param->str_val) + 1;
+        }
+        if (CPARAM_KEYVAL != param->type)
+        {
+            continue;
+        }
+        /* Then one for each key given. */
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            const struct cparam_info * const value_param =
+                cparam_record_key_value(param, key_idx);
+            if (NULL == value_param)
+            {
+                continue;
+            }
+            node_lim++;
+            if (param == value_param)
+            {
+                continue;
+            }
+            /* And one for its value. */
+            node_lim++;
+            if (NULL != value_param->str_val)
+            {
+                str_size += strlen(value_param->str_val) + 1;
+            }
+        }
+    }
+    if (node_lim > UINT16_MAX)
+    {
+        return 0;
+    }
+    const size_t str_offset = sizeof(struct cparam_record_header)
+        + node_lim * sizeof(struct cparam_record_node);
+    // Round up so records can follow each other and stay aligned.
+    const size_t size =
+        (str_offset + str_size + CPARAM_RECORD_ALIGN - 1)
+            & ~(size_t)(CPARAM_RECORD_ALIGN - 1);
+    if (size > UINT32_MAX)
+    {
+        return 0;
+    }
+    if ((NULL == buf) || (buf_size < size))
+    {
+        return size;
+    }
+
+    struct cparam_record_header * const header = buf;
+    header->magic = CPARAM_RECORD_MAGIC;
+    header->size = size;
+    header->node_lim = node_lim;
+    header->reserved = 0;
+    header->str_offset = str_offset;
+
+    struct cparam_record_node * node =
+        (struct cparam_record_node *)(header + 1);
+    char * const str_start = (char *)buf + str_offset;
+    size_t str_len_total = 0;
+    uint16_t node_id = 0;
+    for ( const struct cparam_info * param = start_param;
+        NULL != param;
+        param = cparam_next((struct cparam_info *)param) )
+    {
+        cparam_record_fill(
+            node, node_id, param, str_start, str_offset, &str_len_total
+        );
+        node++;
+        node_id++;
+        if (CPARAM_KEYVAL != param->type)
+        {
+            continue;
+        }
+        for (unsigned int key_idx = 0;key_idx < param->key_lim;key_idx++)
+        {
+            const struct cparam_info * const value_param =
+                cparam_record_key_value(param, key_idx);
+            if (NULL == value_param)
+            {
+                continue;
+            }
+            /* Key on its own, so a keyword value keeps its own key_idx. */
+            node->node_id = node_id;
+            node->type = CPARAM_KEYVAL;
+            node->flags = CPARAM_RECORD_KEY_VALUE;
+            node->key_idx = key_idx;
+            node->int_val = 0;
+            node->str_offset = 0;
+            node->str_len = 0;
+            node++;
+            node_id++;
+            if (param == value_param)
+            {
+                // Flag, no value.
+                continue;
+            }
+            cparam_record_fill(
+                node, node_id, value_param,
+                str_start, str_offset, &str_len_total
+            );
+            node->flags |= CPARAM_RECORD_VALUE;
+            node++;
+            node_id++;
+        }
+    }
+    // Zero the padding, so records with the same values are the same bytes.
+    memset(str_start + str_len_total, 0, size - str_offset - str_len_total);
+    return size;
+}
+
+bool
+cparam_record_check(const void * const buf, const size_t buf_size)
+{
+    const struct cparam_record_header * const header = buf;
+    if ( (NULL == buf)
+      || (buf_size < sizeof(*header))
+      || (0 != ((uintptr_t)buf & (CPARAM_RECORD_ALIGN - 1)))
+      || (CPARAM_RECORD_MAGIC != header->magic)
+      || (header->size > buf_size)
+      || (0 != (header->size & (CPARAM_RECORD_ALIGN - 1)))
+      || (header->str_offset > header->size)
+      || ( header->str_offset
+        != sizeof(*header)
+            + (size_t)header->node_lim * sizeof(struct cparam_record_node) )
+    ) {
+        return false;
+    }
+    const struct cparam_record_node * const nodes = cparam_record_nodes(buf);
+    const char * const record = buf;
+    for (unsigned int node_idx = 0;node_idx < header->node_lim;node_idx++)
+    {
+        const struct cparam_record_node * const node = &nodes[node_idx];
+        if (0 == (node->flags & CPARAM_RECORD_HAS_STR))
+        {
+            continue;
+        }
+        /* String and its NUL must be in the string area. */
+        if ( (node->str_offset < header->str_offset)
+          || (node->str_offset >= header->size)
+          || (node->str_len >= header->size - node->str_offset)
+          || ('\0' != record[node->str_offset + node->str_len]) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const struct cparam_record_node *
+cparam_record_nodes(const void * const record)
+{
+    return (const struct cparam_record_node *)
+        ((const struct cparam_record_header *)record + 1);
+}
+
+const char *
+cparam_record_str(
+    const void * const record,
+    const struct cparam_record_node * const node
+) {
+    if (0 == (node->flags & CPARAM_RECORD_HAS_STR))
+    {
+        return NULL;
+    }
+    return (const char *)record + node->str_offset;
+}
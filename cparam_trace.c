@@ -0,0 +1,289 @@
+#ifdef CPARAM_TRACE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "cparam_trace.h"
+
+/*
+    Fields are only written by the thread that owns the ring, but are atomic
+    so that cparam_trace_export() can read them while it does.
+ */
+struct cparam_trace_event {
+    _Atomic(const char *) name;
+    _Atomic(const char *) arg;
+    atomic_uint_least64_t start_ns;
+    atomic_uint_least64_t dur_ns;
+    atomic_uint tid;
+};
+
+struct cparam_trace_ring {
+    // Set while a thread owns the ring, cleared when the thread exits.
+    atomic_bool in_use;
+    // Total events added. The next one goes in events[event_cnt % max].
+    atomic_uint_least64_t event_cnt;
+    // Events before this were discarded by cparam_trace_clear().
+    atomic_uint_least64_t clear_cnt;
+    struct cparam_trace_event events[CPARAM_TRACE_EVENT_MAX];
+};
+
+static struct cparam_trace_ring cparam_trace_rings[CPARAM_TRACE_THREAD_MAX];
+// Threads that have recorded, to number them.
+static atomic_uint cparam_trace_thread_cnt;
+static atomic_ulong cparam_trace_dropped_cnt;
+static pthread_once_t cparam_trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cparam_trace_key;
+static bool cparam_trace_key_ok;
+static _Thread_local struct cparam_trace_ring * cparam_trace_ring;
+static _Thread_local unsigned int cparam_trace_tid;
+
+uint64_t
+cparam_trace_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* Thread exit, give the ring back. Its events stay until they're replaced. */
+static void
+cparam_trace_ring_release(void * const ring_ptr)
+{
+    struct cparam_trace_ring * const ring = ring_ptr;
+    atomic_store_explicit(&ring->in_use, false, memory_order_release);
+}
+
+static void
+cparam_trace_key_create(void)
+{
+    cparam_trace_key_ok =
+        (0 == pthread_key_create(&cparam_trace_key, cparam_trace_ring_release));
+}
+
+/* Find a ring no thread owns. NULL if all are in use. */
+static struct cparam_trace_ring *
+cparam_trace_ring_claim(void)
+{
+    pthread_once(&cparam_trace_key_once, cparam_trace_key_create);
+    if (!cparam_trace_key_ok)
+    {
+        return NULL;
+    }
+    for (unsigned int ring_idx = 0;
+        ring_idx < CPARAM_TRACE_THREAD_MAX;
+        ring_idx++)
+    {
+        struct cparam_trace_ring * const ring = &cparam_trace_rings[ring_idx];
+        bool in_use = false;
+        if ( atomic_compare_exchange_strong_explicit(
+                &ring->in_use, &in_use, true,
+                memory_order_acquire, memory_order_relaxed
+            )
+        ) {
+            if (0 != pthread_setspecific(cparam_trace_key, ring))
+            {
+                cparam_trace_ring_release(ring);
+                return NULL;
+            }
+            return ring;
+        }
+    }
+    return NULL;
+}
+
+void
+cparam_trace_add(
+    const char * const name,
+    const char * const arg,
+    const uint64_t start_ns
+) {
+    const uint64_t end_ns = cparam_trace_now();
+    struct cparam_trace_ring * ring = cparam_trace_ring;
+    if (NULL == ring)
+    {
+        /* Not recording yet, or every ring was in use last time. */
+        ring = cparam_trace_ring_claim();
+        if (NULL == ring)
+        {
+            atomic_fetch_add_explicit(
+                &cparam_trace_dropped_cnt, 1, memory_order_relaxed
+            );
+            return;
+        }
+        cparam_trace_ring = ring;
+        if (0 == cparam_trace_tid)
+        {
+            cparam_trace_tid = atomic_fetch_add_explicit(
+                &cparam_trace_thread_cnt, 1, memory_order_relaxed
+            ) + 1;
+        }
+    }
+    const uint64_t event_cnt =
+        atomic_load_explicit(&ring->event_cnt, memory_order_relaxed);
+    struct cparam_trace_event * const event =
+        &ring->events[event_cnt & (CPARAM_TRACE_EVENT_MAX - 1)];
+    /* So a reader that sees any of the new event also sees event_cnt at least
+       at this value, and knows the old one is being replaced. */
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&event->name, name, memory_order_relaxed);
+    atomic_store_explicit(&event->arg, arg, memory_order_relaxed);
+    atomic_store_explicit(&event->start_ns, start_ns, memory_order_relaxed);
+    atomic_store_explicit(
+        &event->dur_ns, end_ns - start_ns, memory_order_relaxed
+    );
+    atomic_store_explicit(&event->tid, cparam_trace_tid, memory_order_relaxed);
+    atomic_store_explicit(
+        &ring->event_cnt, event_cnt + 1, memory_order_release
+    );
+}
+
+unsigned long
+cparam_trace_dropped(void)
+{
+    return atomic_load_explicit(
+        &cparam_trace_dropped_cnt, memory_order_relaxed
+    );
+}
+
+static void
+cparam_trace_export_str(FILE * const out, const char * const str)
+{
+    fputc('"', out);
+    for (const unsigned char * str_ptr = (const unsigned char *)str;
+        '\0' != *str_ptr;
+        str_ptr++)
+    {
+        if (('"' == *str_ptr) || ('\\' == *str_ptr))
+        {
+            fprintf(out, "\\%c", *str_ptr);
+        }
+        else if (*str_ptr < ' ')
+        {
+            fprintf(out, "\\u%04x", *str_ptr);
+        }
+        else
+        {
+            fputc(*str_ptr, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/*
+    Copy one event from a ring that may still be recording. False if the
+    owner may have replaced it while it was being copied.
+ */
+static bool
+cparam_trace_event_copy(
+    struct cparam_trace_ring * const ring,
+    const uint64_t event_idx,
+    const char ** const name,
+    const char ** const arg,
+    uint64_t * const start_ns,
+    uint64_t * const dur_ns,
+    unsigned int * const tid
+) {
+    const struct cparam_trace_event * const event =
+        &ring->events[event_idx & (CPARAM_TRACE_EVENT_MAX - 1)];
+    *name = atomic_load_explicit(&event->name, memory_order_relaxed);
+    *arg = atomic_load_explicit(&event->arg, memory_order_relaxed);
+    *start_ns = atomic_load_explicit(&event->start_ns, memory_order_relaxed);
+    *dur_ns = atomic_load_explicit(&event->dur_ns, memory_order_relaxed);
+    *tid = atomic_load_explicit(&event->tid, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    /* The slot is written again for event event_idx + max, which starts once
+       event_cnt gets to that. */
+    return atomic_load_explicit(&ring->event_cnt, memory_order_relaxed)
+        < event_idx + CPARAM_TRACE_EVENT_MAX;
+}
+
+bool
+cparam_trace_export(FILE * const out)
+{
+    const char * sep = "";
+    fprintf(out, "{\"traceEvents\":[");
+    for (unsigned int ring_idx = 0;
+        ring_idx < CPARAM_TRACE_THREAD_MAX;
+        ring_idx++)
+    {
+        struct cparam_trace_ring * const ring = &cparam_trace_rings[ring_idx];
+        const uint64_t event_lim =
+            atomic_load_explicit(&ring->event_cnt, memory_order_acquire);
+        uint64_t event_start =
+            atomic_load_explicit(&ring->clear_cnt, memory_order_relaxed);
+        if (event_start > event_lim)
+        {
+            // Cleared since event_lim was read.
+            event_start = event_lim;
+        }
+        if (event_lim - event_start > CPARAM_TRACE_EVENT_MAX)
+        {
+            event_start = event_lim - CPARAM_TRACE_EVENT_MAX;
+        }
+        for (uint64_t event_idx = event_start;
+            event_idx < event_lim;
+            event_idx++)
+        {
+            const char * name;
+            const char * arg;
+            uint64_t start_ns;
+            uint64_t dur_ns;
+            unsigned int tid;
+            if ( !cparam_trace_event_copy(
+                    ring, event_idx, &name, &arg, &start_ns, &dur_ns, &tid
+                )
+            ) {
+                continue;
+            }
+            /* Times are in microseconds. */
+            fprintf(out,
+                "%s\n{\"name\":\"%s\",\"cat\":\"cparam\",\"ph\":\"X\","
+                "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":1,\"tid\":%u",
+                sep,
+                name,
+                (unsigned long long)(start_ns / 1000),
+                (unsigned int)(start_ns % 1000),
+                (unsigned long long)(dur_ns / 1000),
+                (unsigned int)(dur_ns % 1000),
+                tid
+            );
+            if (NULL != arg)
+            {
+                fprintf(out, ",\"args\":{\"param\":");
+                cparam_trace_export_str(out, arg);
+                fprintf(out, "}");
+            }
+            fprintf(out, "}");
+            sep = ",";
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\","
+        "\"otherData\":{\"dropped\":%lu}}\n",
+        cparam_trace_dropped()
+    );
+    return !ferror(out);
+}
+
+void
+cparam_trace_clear(void)
+{
+    for (unsigned int ring_idx = 0;
+        ring_idx < CPARAM_TRACE_THREAD_MAX;
+        ring_idx++)
+    {
+        struct cparam_trace_ring * const ring = &cparam_trace_rings[ring_idx];
+        atomic_store_explicit(&ring->clear_cnt,
+            atomic_load_explicit(&ring->event_cnt, memory_order_relaxed),
+            memory_order_relaxed
+        );
+    }
+    atomic_store_explicit(&cparam_trace_dropped_cnt, 0, memory_order_relaxed);
+}
+#else
+/* ISO C doesn't allow an empty translation unit. */
+typedef int cparam_trace_not_built;
+#endif  // CPARAM_TRACE
@@ -0,0 +1,56 @@
+#ifndef CPARAM_TRACE_H
+#define CPARAM_TRACE_H
+/*
+    Optional tracing of parsing, actions and help printing. Only built if
+    CPARAM_TRACE is defined, otherwise the trace points compile to nothing.
+
+    Each thread records into its own ring buffer, so recording never waits on
+    another thread. When a ring buffer is full the oldest events are replaced.
+    A thread's ring buffer is given back when the thread exits, for another
+    thread to use.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef CPARAM_TRACE
+
+// Events kept for each thread. Must be a power of 2.
+#ifndef CPARAM_TRACE_EVENT_MAX
+#define CPARAM_TRACE_EVENT_MAX 4096
+#endif
+// Threads that can record at once. Events from any more threads are dropped,
+// and counted by cparam_trace_dropped().
+#ifndef CPARAM_TRACE_THREAD_MAX
+#define CPARAM_TRACE_THREAD_MAX 8
+#endif
+
+uint64_t cparam_trace_now(void);
+void cparam_trace_add(
+    const char * const name,
+    const char * const arg, // May be NULL.
+    const uint64_t start_ns
+);
+
+/*
+    Write all recorded events as Chrome trace JSON, which can be opened in
+    chrome://tracing or Perfetto. Threads can keep recording while this runs,
+    events replaced while it's reading them are left out.
+ */
+bool cparam_trace_export(FILE * const out);
+void cparam_trace_clear(void);
+// Events dropped because every ring buffer was in use.
+unsigned long cparam_trace_dropped(void);
+
+#define CPARAM_TRACE_BEGIN(start) \
+    const uint64_t start = cparam_trace_now()
+#define CPARAM_TRACE_END(start, name, arg) \
+    cparam_trace_add(name, arg, start)
+
+#else
+
+#define CPARAM_TRACE_BEGIN(start)
+#define CPARAM_TRACE_END(start, name, arg)
+
+#endif  // CPARAM_TRACE
+#endif  // CPARAM_TRACE_H